@@ -0,0 +1,6 @@
+// This is a stand-in for avr-libc's <avr/interrupt.h>; see host/avr/io.h.
+
+#pragma once
+
+#define cli()
+#define sei()
@@ -0,0 +1,47 @@
+// This is a stand-in for avr-libc's <avr/io.h> that lets the AVR code in this
+// directory be checked on your computer.  It only has the registers that the
+// code here uses, at their ATmega324P addresses.
+//
+// When LED_STRIP_SIM is defined, for led_strip_sim, each register is just its
+// data memory address, so that the assembly operands can be read from the
+// preprocessed code.  Otherwise, for led_strip_player_sim, each register is
+// the memory that led_strip_host_io returns for its address, which lets the
+// program model the hardware behind it.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef LED_STRIP_SIM
+#define _SFR_MEM8(address) (address)
+#define _SFR_MEM16(address) (address)
+#else
+volatile void * led_strip_host_io(uint16_t address);
+#define _SFR_MEM8(address) (*(volatile uint8_t *)led_strip_host_io(address))
+#define _SFR_MEM16(address) (*(volatile uint16_t *)led_strip_host_io(address))
+#endif
+#define _SFR_IO8(address) _SFR_MEM8((address) + 0x20)
+#define _SFR_IO_ADDR(sfr) ((sfr) - 0x20)
+
+#define PORTA  _SFR_IO8(0x02)
+#define DDRA   _SFR_IO8(0x01)
+#define PORTB  _SFR_IO8(0x05)
+#define DDRB   _SFR_IO8(0x04)
+#define PORTC  _SFR_IO8(0x08)
+#define DDRC   _SFR_IO8(0x07)
+#define PORTD  _SFR_IO8(0x0B)
+#define DDRD   _SFR_IO8(0x0A)
+
+#define SPCR   _SFR_IO8(0x2C)
+#define SPE    6
+#define MSTR   4
+#define SPSR   _SFR_IO8(0x2D)
+#define SPIF   7
+#define SPI2X  0
+#define SPDR   _SFR_IO8(0x2E)
+
+#define TCCR1B _SFR_MEM8(0x81)
+#define CS10   0
+#define CS11   1
+#define CS12   2
+#define TCNT1  _SFR_MEM16(0x84)
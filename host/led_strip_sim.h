@@ -0,0 +1,16 @@
+// led_strip_sim runs this file through the C preprocessor with the same
+// options as each writer to find out the settings that led_strip.h gives the
+// writer.  It is not meant to be compiled.
+
+#include <avr/io.h>
+#include "led_strip.h"
+
+led_strip_sim_settings(
+  LED_STRIP_0_PULSE_NS, LED_STRIP_1_PULSE_NS,
+  LED_STRIP_0_LOW_MIN_NS, LED_STRIP_1_LOW_MIN_NS,
+  LED_STRIP_0_PULSE_MIN_NS, LED_STRIP_0_PULSE_MAX_NS,
+  LED_STRIP_1_PULSE_MIN_NS, LED_STRIP_1_PULSE_MAX_NS,
+  LED_STRIP_PORT, LED_STRIP_PIN,
+  LED_STRIP1_PORT, LED_STRIP1_PIN,
+  LED_STRIP2_PORT, LED_STRIP2_PIN,
+  LED_STRIP3_PORT, LED_STRIP3_PIN)
@@ -0,0 +1,6 @@
+// This is a stand-in for avr-libc's <util/delay.h>; see host/avr/io.h.
+
+#pragma once
+
+void _delay_us(double us);
+void _delay_ms(double ms);
@@ -0,0 +1,251 @@
+// This is the header for the library of AVR code for driving the RGB LED
+// strips from Pololu.
+//
+// The library has several interchangeable ways of sending colors to the LEDs:
+//
+//   led_strip.c       led_strip_send_color() for one LED strip, using "sbi"
+//                     and "cbi" instructions, which only work on registers in
+//                     the first 32 bytes of I/O memory.
+//   led_strip_ds.c    led_strip_send_color() for one LED strip on any AVR pin.
+//   led_strip_write.c led_strip_write(), which sends a series of colors with
+//                     led_strip_send_color().
+//   led_strip2.c      led_strip_write2() for two LED strips at the same time.
+//   led_strip3.c      led_strip_write3() for three LED strips at the same time.
+//
+// Only one of led_strip.c and led_strip_ds.c can be built into the library;
+// see LED_STRIP_BACKEND in the Makefile.  led_strip_encode.c is a reference
+// encoder written in plain C, which also builds on your computer, that
+// produces the same bytes the AVR code sends.
+//
+// All of the settings below can be changed by defining them before this file is
+// included, usually with -D options on the compiler command line (see the
+// Makefile).  F_CPU, the frequency your AVR is running at, must be defined the
+// same way.
+
+#pragma once
+
+#include <stdint.h>
+
+// These lines specify what pin the LED strip is on for led_strip_write.
+// You will either need to attach the LED strip's data line to PC0 or change these
+// lines to specify a different pin.  The pin can be changed on its own, but the
+// port and its DDR register must be changed together.
+#if !defined(LED_STRIP_PORT) && !defined(LED_STRIP_DDR)
+#define LED_STRIP_PORT PORTC
+#define LED_STRIP_DDR  DDRC
+#elif !defined(LED_STRIP_PORT) || !defined(LED_STRIP_DDR)
+#error "LED_STRIP_PORT and LED_STRIP_DDR must be defined together"
+#endif
+#ifndef LED_STRIP_PIN
+#define LED_STRIP_PIN  0
+#endif
+
+// These lines specify what pins the LED strips are on for led_strip_write2 and
+// led_strip_write3.
+#if !defined(LED_STRIP1_PORT) && !defined(LED_STRIP1_DDR)
+#define LED_STRIP1_PORT PORTC
+#define LED_STRIP1_DDR  DDRC
+#elif !defined(LED_STRIP1_PORT) || !defined(LED_STRIP1_DDR)
+#error "LED_STRIP1_PORT and LED_STRIP1_DDR must be defined together"
+#endif
+#ifndef LED_STRIP1_PIN
+#define LED_STRIP1_PIN  0
+#endif
+
+#if !defined(LED_STRIP2_PORT) && !defined(LED_STRIP2_DDR)
+#define LED_STRIP2_PORT PORTC
+#define LED_STRIP2_DDR  DDRC
+#elif !defined(LED_STRIP2_PORT) || !defined(LED_STRIP2_DDR)
+#error "LED_STRIP2_PORT and LED_STRIP2_DDR must be defined together"
+#endif
+#ifndef LED_STRIP2_PIN
+#define LED_STRIP2_PIN  1
+#endif
+
+#if !defined(LED_STRIP3_PORT) && !defined(LED_STRIP3_DDR)
+#define LED_STRIP3_PORT PORTD
+#define LED_STRIP3_DDR  DDRD
+#elif !defined(LED_STRIP3_PORT) || !defined(LED_STRIP3_DDR)
+#error "LED_STRIP3_PORT and LED_STRIP3_DDR must be defined together"
+#endif
+#ifndef LED_STRIP3_PIN
+#define LED_STRIP3_PIN  0
+#endif
+
+// This line specifies the timing profile for the LEDs you are using with
+// led_strip_write.  See the LED_STRIP_TIMING_* definitions below for the choices.
+#ifndef LED_STRIP_TIMING
+#define LED_STRIP_TIMING LED_STRIP_TIMING_WS2812B
+#endif
+
+// These lines specify a limit on the current drawn by the LEDs, which protects
+// your power supply.  LED_STRIP_CURRENT_LIMIT is the budget in mA, or 0 for no
+// limit.  LED_STRIP_CHANNEL_CURRENT is the current in mA drawn by one color
+// channel of one LED at full brightness (about 17 mA for the LEDs from Pololu,
+// which draw about 50 mA each when set to white).  Every writer and
+// led_strip_player.c apply the limit; led_strip_write2 and led_strip_write3
+// apply it to the total of all their strips.
+#ifndef LED_STRIP_CURRENT_LIMIT
+#define LED_STRIP_CURRENT_LIMIT   0
+#endif
+#ifndef LED_STRIP_CHANNEL_CURRENT
+#define LED_STRIP_CHANNEL_CURRENT 17
+#endif
+
+// Timing profiles.  Each profile specifies the length of a 0 pulse, the length
+// of a 1 pulse, and the "period" (the time from the start of one bit to the start
+// of the next) in nanoseconds, the shortest time the line can be low after a
+// 0 and after a 1, and the shortest and longest each pulse can be.  The limits
+// come from the datasheets and are checked by led_strip_sim.  The pulses and the period are rounded to a whole number of
+// CPU cycles, and lengthened if they are too short for the code to achieve at
+// F_CPU.  The period is also lengthened if rounding would leave the line low for
+// less than the shortest allowed time.
+#define LED_STRIP_TIMING_WS2812B            1  // Default; also works for SK6812 and WS2811 (high-speed mode).
+#define LED_STRIP_TIMING_SK6812             2
+#define LED_STRIP_TIMING_WS2811_LOW_SPEED   3  // WS2811 with its SET pin selecting 400 kHz.
+#define LED_STRIP_TIMING_TM1804             4  // High-speed TM1804 (items #2543, #2544, and #2545).
+#define LED_STRIP_TIMING_TM1804_LOW_SPEED   5  // Low-speed TM1804 (items #2540, #2541, and #2542).
+#define LED_STRIP_TIMING_FAST               6  // Tightest timing allowed by the WS2812B datasheet.
+
+#if LED_STRIP_TIMING == LED_STRIP_TIMING_WS2812B || LED_STRIP_TIMING == LED_STRIP_TIMING_TM1804
+// The low times are the shortest the SK6812 datasheet allows (0.9 us and
+// 0.6 us +/- 150 ns), which are longer than the WS2812B needs.  The pulses are
+// the WS2812B's 0.4 us and 0.8 us +/- 150 ns.
+#define LED_STRIP_0_PULSE_NS     400
+#define LED_STRIP_1_PULSE_NS     850
+#define LED_STRIP_PERIOD_NS     1300
+#define LED_STRIP_0_LOW_MIN_NS   750
+#define LED_STRIP_1_LOW_MIN_NS   450
+#define LED_STRIP_0_PULSE_MIN_NS 250
+#define LED_STRIP_0_PULSE_MAX_NS 550
+#define LED_STRIP_1_PULSE_MIN_NS 650
+#define LED_STRIP_1_PULSE_MAX_NS 950
+#elif LED_STRIP_TIMING == LED_STRIP_TIMING_SK6812
+// The SK6812 datasheet allows 0.3 us and 0.6 us +/- 150 ns high.
+#define LED_STRIP_0_PULSE_NS     300
+#define LED_STRIP_1_PULSE_NS     600
+#define LED_STRIP_PERIOD_NS     1250
+#define LED_STRIP_0_LOW_MIN_NS   750
+#define LED_STRIP_1_LOW_MIN_NS   450
+#define LED_STRIP_0_PULSE_MIN_NS 150
+#define LED_STRIP_0_PULSE_MAX_NS 450
+#define LED_STRIP_1_PULSE_MIN_NS 450
+#define LED_STRIP_1_PULSE_MAX_NS 750
+#elif LED_STRIP_TIMING == LED_STRIP_TIMING_WS2811_LOW_SPEED || LED_STRIP_TIMING == LED_STRIP_TIMING_TM1804_LOW_SPEED
+// The WS2811 datasheet allows 0.5 us and 1.2 us +/- 150 ns high, and 2.0 us
+// and 1.3 us +/- 150 ns low.
+#define LED_STRIP_0_PULSE_NS     500
+#define LED_STRIP_1_PULSE_NS    1200
+#define LED_STRIP_PERIOD_NS     2500
+#define LED_STRIP_0_LOW_MIN_NS  1850
+#define LED_STRIP_1_LOW_MIN_NS  1150
+#define LED_STRIP_0_PULSE_MIN_NS  350
+#define LED_STRIP_0_PULSE_MAX_NS  650
+#define LED_STRIP_1_PULSE_MIN_NS 1050
+#define LED_STRIP_1_PULSE_MAX_NS 1350
+#elif LED_STRIP_TIMING == LED_STRIP_TIMING_FAST
+// The WS2812B datasheet allows 0.4 us +/- 150 ns for a 0 pulse and 0.8 us +/- 150 ns
+// for a 1 pulse, with at least 700 ns low after a 0 and 300 ns low after a 1.
+// These are not guaranteed to work with SK6812 LEDs, which need longer low times.
+#define LED_STRIP_0_PULSE_NS     300
+#define LED_STRIP_1_PULSE_NS     700
+#define LED_STRIP_PERIOD_NS     1000
+#define LED_STRIP_0_LOW_MIN_NS   700
+#define LED_STRIP_1_LOW_MIN_NS   300
+#define LED_STRIP_0_PULSE_MIN_NS 250
+#define LED_STRIP_0_PULSE_MAX_NS 550
+#define LED_STRIP_1_PULSE_MIN_NS 650
+#define LED_STRIP_1_PULSE_MAX_NS 950
+#else
+#error "Unsupported LED_STRIP_TIMING"
+#endif
+
+#define LED_STRIP_CYCLES(ns) (((ns) * (F_CPU / 1000000) + 500) / 1000)
+#define LED_STRIP_CYCLES_UP(ns) (((ns) * (F_CPU / 1000000) + 999) / 1000)
+#define LED_STRIP_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// The shortest pulses and period the assembly in led_strip_send_color can produce
+// are 3, 5, and 8 cycles.
+#define LED_STRIP_0_PULSE_CYCLES LED_STRIP_MAX(LED_STRIP_CYCLES(LED_STRIP_0_PULSE_NS), 3)
+#define LED_STRIP_1_PULSE_CYCLES LED_STRIP_MAX(LED_STRIP_CYCLES(LED_STRIP_1_PULSE_NS), LED_STRIP_0_PULSE_CYCLES + 2)
+#define LED_STRIP_PERIOD_CYCLES  LED_STRIP_MAX( \
+  LED_STRIP_MAX(LED_STRIP_CYCLES(LED_STRIP_PERIOD_NS), LED_STRIP_1_PULSE_CYCLES + 3), \
+  LED_STRIP_MAX(LED_STRIP_0_PULSE_CYCLES + LED_STRIP_CYCLES_UP(LED_STRIP_0_LOW_MIN_NS), \
+    LED_STRIP_1_PULSE_CYCLES + LED_STRIP_CYCLES_UP(LED_STRIP_1_LOW_MIN_NS)))
+
+// The rgb_color struct represents the color for an 8-bit RGB LED.
+// Examples:
+//   Black:      (rgb_color){ 0, 0, 0 }
+//   Pure red:   (rgb_color){ 255, 0, 0 }
+//   Pure green: (rgb_color){ 0, 255, 0 }
+//   Pure blue:  (rgb_color){ 0, 0, 255 }
+//   White:      (rgb_color){ 255, 255, 255}
+typedef struct rgb_color
+{
+  uint8_t red, green, blue;
+} rgb_color;
+
+// These macros do the work that every writer does around sending colors.
+// LED_STRIP_OUTPUT sets a pin to be an output driving low.  LED_STRIP_BEGIN
+// disables interrupts, because we don't want our pulse timing to be messed
+// up.  LED_STRIP_END re-enables them and sends the reset signal, which
+// makes the LEDs show the colors they were sent.  The code that uses them
+// must include <avr/interrupt.h> and <util/delay.h>.
+#define LED_STRIP_OUTPUT(port, ddr, pin) do { (port) &= ~(1 << (pin)); (ddr) |= (1 << (pin)); } while (0)
+#define LED_STRIP_BEGIN() cli()
+#define LED_STRIP_END() do { sei(); _delay_us(80); } while (0)
+
+// led_strip_write sends a series of colors to the LED strip, updating the LEDs.
+// The colors parameter should point to an array of rgb_color structs that hold
+// the colors to send.
+// The count parameter is the number of colors to send.
+// See led_strip.c for the timing details.
+void led_strip_write(rgb_color * colors, uint16_t count);
+
+// led_strip_send_color sends one color to the LED strip as it is.
+// It is what led_strip_write uses for each color, and it is meant for code
+// that produces the colors as it goes, like led_strip_player.c.  The caller
+// must set up the pin with LED_STRIP_OUTPUT, call LED_STRIP_BEGIN before the
+// first color and LED_STRIP_END after the last, and apply any current limit.
+void led_strip_send_color(const rgb_color * color);
+
+// led_strip_write2 and led_strip_write3 are like led_strip_write, but they send
+// count colors to each of two or three LED strips at the same time.
+// They do not apply LED_STRIP_TIMING, but they do apply LED_STRIP_CURRENT_LIMIT
+// to the colors of all their strips together.
+void led_strip_write2(rgb_color * colors1, rgb_color * colors2, uint16_t count);
+void led_strip_write3(rgb_color * colors1, rgb_color * colors2, rgb_color * colors3, uint16_t count);
+
+// led_strip_scale is the brightness that the writers apply to every channel,
+// in units of 1/256.  Each call to a writer adds up the colors it sends on all
+// of its strips, and sets this to led_strip_next_scale() of that sum so that
+// sending the same colors again would stay within LED_STRIP_CURRENT_LIMIT.
+// The writers share it, so the limit covers the LEDs updated by one call; if
+// your strips are updated by several calls, divide the budget between them.
+// It only exists if LED_STRIP_CURRENT_LIMIT is not 0.
+#if LED_STRIP_CURRENT_LIMIT
+extern uint16_t led_strip_scale;
+#endif
+
+// led_strip_next_scale returns the scale that keeps colors whose channels add
+// up to total within LED_STRIP_CURRENT_LIMIT.
+uint16_t led_strip_next_scale(uint32_t total);
+
+// led_strip_scale_color returns a color scaled by scale/256.
+static inline rgb_color led_strip_scale_color(const rgb_color * color, uint16_t scale)
+{
+  rgb_color scaled = {
+    color->red * scale >> 8,
+    color->green * scale >> 8,
+    color->blue * scale >> 8,
+  };
+  return scaled;
+}
+
+// led_strip_encode is the reference for what the AVR code sends: it writes the
+// 3 * count bytes that led_strip_write sends for the given colors to bytes,
+// in the order they are sent.  Each byte is sent most-significant bit first.
+// The scale parameter is the led_strip_scale that applies (256 if there is no
+// current limit).  Each strip driven by led_strip_write2 or led_strip_write3
+// receives the same bytes as led_strip_encode with the same scale.
+void led_strip_encode(const rgb_color * colors, uint16_t count, uint16_t scale, uint8_t * bytes);
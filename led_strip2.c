@@ -2,42 +2,54 @@
    This version can actually drive two LED strips at the same time.
    For a simpler version with more comments that does one LED strip at a time,
    see led_strip.c.
-   This version only supports 20 MHz processors.
+   This version supports 20 MHz, 16 MHz and 8 MHz processors.
  */
 
-#define F_CPU 20000000
-
-#define LED_STRIP1_PORT PORTC
-#define LED_STRIP1_DDR  DDRC
-#define LED_STRIP1_PIN  0
-
-#define LED_STRIP2_PORT PORTC
-#define LED_STRIP2_DDR  DDRC
-#define LED_STRIP2_PIN  1
-
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
-
-typedef struct rgb_color
+#include "led_strip.h"
+
+/* At 20 MHz the typical bit takes 1.45 microseconds, so you can update two strips of 30 LEDs each in less than 1.1 ms.
+   Timing details at 20 MHz:
+     0 pulse  = 400 ns (strip 1), 450 ns (strip 2)
+     1 pulse  = 900 ns (strip 1), 750 ns (strip 2)
+     "period" = 1450 ns
+   Timing details at 16 MHz:
+     0 pulse  = 312.5 ns (strip 1), 312.5 to 375 ns (strip 2)
+     1 pulse  = 875 ns
+     "period" = 1750 ns
+   Timing details at 8 MHz:
+     0 pulse  = 375 ns
+     1 pulse  = 875 ns
+     "period" = 1625 to 2625 ns  */
+void __attribute__((noinline)) led_strip_write2(rgb_color * colors1, rgb_color * colors2, uint16_t count)
 {
-  unsigned char red, green, blue;
-} rgb_color;
+  LED_STRIP_OUTPUT(LED_STRIP1_PORT, LED_STRIP1_DDR, LED_STRIP1_PIN);
+  LED_STRIP_OUTPUT(LED_STRIP2_PORT, LED_STRIP2_DDR, LED_STRIP2_PIN);
 
-/* The typical bit takes 1.45 microseconds, so you can update two strips of 30 LEDs each in less than 1.1 ms.  */
-void __attribute__((noinline)) led_strip_write2(rgb_color * colors1, rgb_color * colors2, unsigned int count)
-{
-  LED_STRIP1_PORT &= ~(1<<LED_STRIP1_PIN);
-  LED_STRIP1_DDR |= (1<<LED_STRIP1_PIN);
-
-  LED_STRIP2_PORT &= ~(1<<LED_STRIP2_PIN);
-  LED_STRIP2_DDR |= (1<<LED_STRIP2_PIN);
+#if LED_STRIP_CURRENT_LIMIT
+  uint32_t total = 0;  // sum of all the channels requested on both strips
+  uint16_t scale = led_strip_scale;
+#endif
 
-  cli();   // Disable interrupts temporarily because we don't want our pulse timing to be messed up.
+  LED_STRIP_BEGIN();
   while(count--)
   {
     unsigned char b1, b2;  // brightness values
 
+#if LED_STRIP_CURRENT_LIMIT
+    // Add these colors to the total and send scaled copies of them instead.
+    total += colors1->red + colors1->green + colors1->blue;
+    total += colors2->red + colors2->green + colors2->blue;
+    rgb_color scaled1 = led_strip_scale_color(colors1, scale);
+    rgb_color scaled2 = led_strip_scale_color(colors2, scale);
+    rgb_color * next1 = colors1 + 1;
+    rgb_color * next2 = colors2 + 1;
+    colors1 = &scaled1;
+    colors2 = &scaled2;
+#endif
+
     // Send a color to the LED strip.
     // The assembly below also increments the 'colors' pointer,
     // it will be pointing to the next color at the end of this loop.
@@ -61,6 +73,11 @@ void __attribute__((noinline)) led_strip_write2(rgb_color * colors1, rgb_color *
 
         // send_led_strip_byte subroutine:  Sends a byte to the LED strip.
         "send_led_strip_byte%=:\n"
+#if F_CPU == 8000000
+        // At 8 MHz, calling a subroutine for each bit would take almost a third
+        // of the time, so the bits are sent by the code below repeated 8 times.
+        ".rept 8\n"                              // Send bits 7 through 0.
+#else
         "rcall send_led_strip_bit%=\n"  // Send most-significant bit (bit 7).
         "rcall send_led_strip_bit%=\n"
         "rcall send_led_strip_bit%=\n"
@@ -75,6 +92,8 @@ void __attribute__((noinline)) led_strip_write2(rgb_color * colors1, rgb_color *
         // high for some time.  The amount of time the line is high depends on whether the bit is 0 or 1,
         // but this function always takes the same time (2 us).
         "send_led_strip_bit%=:\n"
+#endif
+#if F_CPU == 20000000
         "sbi %6, %7\n"                           // #1: Drive high.
         "nop\n" "nop\n"
 
@@ -89,6 +108,63 @@ void __attribute__((noinline)) led_strip_write2(rgb_color * colors1, rgb_color *
 
         "cbi %6, %7\n"                           // #1: Drive low.
         "cbi %8, %9\n"                           // #2: Drive low.
+#elif F_CPU == 16000000
+        // There is no time to rotate strip 2's bit into carry after strip 1's
+        // 0 pulse ends, so strip 1's bit goes in the T flag instead.
+        "bst %2, 7\n"                            // #1: Copy the bit to send into T.
+        "rol %3\n"                               // #2: Rotate left through carry.
+        "sbi %6, %7\n"                           // #1: Drive high.
+        "sbi %8, %9\n"                           // #2: Drive high.
+        "brts .+2\n" "cbi %6, %7\n"              // #1: If the bit to send is 0, drive the line low now.
+        "brcs .+2\n" "cbi %8, %9\n"              // #2: If the bit to send is 0, drive the line low now.
+        "brtc .+4\n" "nop\n" "nop\n"             // Fix the timing.
+        "brcc .+4\n" "nop\n" "nop\n"             // Fix the timing.
+
+        "cbi %6, %7\n"                           // #1: Drive low.
+        "cbi %8, %9\n"                           // #2: Drive low.
+        "lsl %2\n"                               // #1: Move on to the next bit.
+#elif F_CPU == 8000000
+        // At 8 MHz there is no time for a branch between driving both lines high
+        // and ending a 0 pulse, so both bits are decoded first, and each of the
+        // four combinations has its own sequence.  The sequences drive the lines
+        // in different orders, so the 0 pulses are 3 cycles and the 1 pulses are
+        // 7 cycles in every case.
+        "bst %3, 7\n"                            // #2: Copy the bit to send into T.
+        "lsl %3\n"                               // #2: Move on to the next bit.
+        "lsl %2\n"                               // #1: Shift the bit to send into carry.
+        "brcs 1f\n"
+        "brts 2f\n"
+
+        // Strip 1 sends a 0 and strip 2 sends a 0.
+        "sbi %6, %7\n" "nop\n" "cbi %6, %7\n"     // #1: 0 pulse.
+        "sbi %8, %9\n" "nop\n" "cbi %8, %9\n"     // #2: 0 pulse.
+        "rjmp 4f\n"
+
+        "1: brts 3f\n"
+
+        // Strip 1 sends a 1 and strip 2 sends a 0.
+        "sbi %6, %7\n"                           // #1: Drive high.
+        "sbi %8, %9\n" "nop\n" "cbi %8, %9\n"     // #2: 0 pulse.
+        "cbi %6, %7\n"                           // #1: Drive low.
+        "rjmp 4f\n"
+
+        // Strip 1 sends a 0 and strip 2 sends a 1.
+        "2: sbi %8, %9\n"                        // #2: Drive high.
+        "sbi %6, %7\n" "nop\n" "cbi %6, %7\n"     // #1: 0 pulse.
+        "cbi %8, %9\n"                           // #2: Drive low.
+        "rjmp 4f\n"
+
+        // Strip 1 sends a 1 and strip 2 sends a 1.
+        "3: sbi %6, %7\n"                        // #1: Drive high.
+        "sbi %8, %9\n"                           // #2: Drive high.
+        "nop\n" "nop\n" "nop\n"
+        "cbi %6, %7\n"                           // #1: Drive low.
+        "cbi %8, %9\n"                           // #2: Drive low.
+        "4:\n"
+        ".endr\n"
+#else
+#error "Unsupported F_CPU"
+#endif
         "ret\n"
         "led_strip_asm_end%=: "
         : "=b" (colors1),
@@ -103,37 +179,17 @@ void __attribute__((noinline)) led_strip_write2(rgb_color * colors1, rgb_color *
           "I" (LED_STRIP2_PIN)                  // %9 is the pin number
     );
 
+#if LED_STRIP_CURRENT_LIMIT
+    colors1 = next1;
+    colors2 = next2;
+#endif
+
     // Uncomment the line below to temporarily enable interrupts between each color.
     //sei(); asm volatile("nop\n"); cli();
   }
-  sei();          // Re-enable interrupts now that we are done.
-  _delay_us(80);  // Send the reset signal.
-}
+  LED_STRIP_END();
 
-#define LED_COUNT 60
-rgb_color colors1[LED_COUNT], colors2[LED_COUNT];
-
-int main()
-{
-  unsigned int time = 0;
-
-  while(1)
-  {
-    unsigned int i;
-    for(i = 0; i < LED_COUNT; i++)
-    {
-      unsigned char x = (time >> 2) - 8*i;
-      colors1[i] = (rgb_color){ x, 255 - x, x };
-
-      x = (time >> 2) - 50*i;
-      if (x > 127){ x = 255 - x; }
-      x = x*x >> 8;
-      colors2[i] = (rgb_color){ 0, 0, 2*x };
-    }
-
-    led_strip_write2(colors1, colors2, LED_COUNT);
-
-    _delay_ms(20);
-    time += 20;
-  }
+#if LED_STRIP_CURRENT_LIMIT
+  led_strip_scale = led_strip_next_scale(total);
+#endif
 }
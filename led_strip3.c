@@ -2,52 +2,62 @@
    This version can actually drive three LED strips at the same time.
    For a simpler version with more comments that does one LED strip at a time,
    see led_strip.c.
-   This version only supports 20 MHz processors.
+   This version supports 20 MHz and 16 MHz processors.
  */
 
-#define F_CPU 20000000
-
-#define LED_STRIP1_PORT PORTC
-#define LED_STRIP1_DDR  DDRC
-#define LED_STRIP1_PIN  0
-
-#define LED_STRIP2_PORT PORTC
-#define LED_STRIP2_DDR  DDRC
-#define LED_STRIP2_PIN  1
-
-#define LED_STRIP3_PORT PORTD
-#define LED_STRIP3_DDR  DDRD
-#define LED_STRIP3_PIN  0
-
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
-
-typedef struct rgb_color
-{
-  unsigned char red, green, blue;
-} rgb_color;
-
-/** The timing of this function is the same as led_strip_write() in led_strip.c except
-  it does two chains of LED strips simultaneously.
-  Updating 3*30 LEDs takes less than 1 ms.  **/
-void __attribute__((noinline)) led_strip_write3(rgb_color * colors1, rgb_color * colors2, rgb_color * colors3, unsigned int count)
+#include "led_strip.h"
+
+/** This function sends count colors to each of three chains of LED strips
+  simultaneously, with its own fixed timing that does not follow
+  LED_STRIP_TIMING.  At 20 MHz, updating 3*30 LEDs takes less than 1 ms.
+  Timing details at 20 MHz:
+    0 pulse  = 400 ns (strip 1), 400 to 450 ns (strips 2 and 3)
+    1 pulse  = 800 ns
+    "period" = 1250 ns
+  Timing details at 16 MHz:
+    0 pulse  = 375 ns
+    1 pulse  = 750 ns
+    "period" = 1812.5 to 2000 ns
+  The 16 MHz period is longer than the 1375 ns of led_strip_write(), but because
+  three strips are sent at once, each strip still takes less time.
+  At 8 MHz there is not enough time to start all three pulses and still end a
+  0 pulse soon enough, so use led_strip2.c or led_strip.c instead.  **/
+void __attribute__((noinline)) led_strip_write3(rgb_color * colors1, rgb_color * colors2, rgb_color * colors3, uint16_t count)
 {
-  LED_STRIP1_PORT &= ~(1<<LED_STRIP1_PIN);
-  LED_STRIP1_DDR |= (1<<LED_STRIP1_PIN);
+  LED_STRIP_OUTPUT(LED_STRIP1_PORT, LED_STRIP1_DDR, LED_STRIP1_PIN);
+  LED_STRIP_OUTPUT(LED_STRIP2_PORT, LED_STRIP2_DDR, LED_STRIP2_PIN);
+  LED_STRIP_OUTPUT(LED_STRIP3_PORT, LED_STRIP3_DDR, LED_STRIP3_PIN);
 
-  LED_STRIP2_PORT &= ~(1<<LED_STRIP2_PIN);
-  LED_STRIP2_DDR |= (1<<LED_STRIP2_PIN);
+#if LED_STRIP_CURRENT_LIMIT
+  uint32_t total = 0;  // sum of all the channels requested on the three strips
+  uint16_t scale = led_strip_scale;
+#endif
 
-  LED_STRIP3_PORT &= ~(1<<LED_STRIP3_PIN);
-  LED_STRIP3_DDR |= (1<<LED_STRIP3_PIN);
-
-  cli();   // Disable interrupts temporarily because we don't want our pulse timing to be messed up.
+  LED_STRIP_BEGIN();
   while(count--)
   {
     unsigned char b1, b2, b3;  // brightness values
     unsigned char i;           // counts down from 8 to 0
 
+#if LED_STRIP_CURRENT_LIMIT
+    // Add these colors to the total and send scaled copies of them instead.
+    total += colors1->red + colors1->green + colors1->blue;
+    total += colors2->red + colors2->green + colors2->blue;
+    total += colors3->red + colors3->green + colors3->blue;
+    rgb_color scaled1 = led_strip_scale_color(colors1, scale);
+    rgb_color scaled2 = led_strip_scale_color(colors2, scale);
+    rgb_color scaled3 = led_strip_scale_color(colors3, scale);
+    rgb_color * next1 = colors1 + 1;
+    rgb_color * next2 = colors2 + 1;
+    rgb_color * next3 = colors3 + 1;
+    colors1 = &scaled1;
+    colors2 = &scaled2;
+    colors3 = &scaled3;
+#endif
+
     // Send a color to the LED strip.
     // The assembly below also increments the 'colors' pointer,
     // it will be pointing to the next color at the end of this loop.
@@ -75,6 +85,7 @@ void __attribute__((noinline)) led_strip_write3(rgb_color * colors1, rgb_color *
         "rcall send_led_strip_byte%=\n"  // Send blue component.
         "rjmp led_strip_asm_end%=\n"     // Jump past the assembly subroutines.
 
+#if F_CPU == 20000000
 // Macros for driving an output high
 #define SBI1 "sbi %10, %11\n"   // happens on cycle 1
 #define SBI2 "sbi %12, %13\n"   // happens on cycle 3
@@ -223,6 +234,80 @@ void __attribute__((noinline)) led_strip_write3(rgb_color * colors1, rgb_color *
 #undef BRNE_ALT
 #undef BRNE_0
 #undef DONE
+#elif F_CPU == 16000000
+// At 16 MHz, a 0 pulse only has room for the three "sbi" instructions, so all
+// three bits are decoded before any output goes high.  Each of the eight
+// combinations has its own straight-line sequence that ends the 0 pulses on
+// cycles 6, 8 and 10 and the 1 pulses on cycles 12, 14 and 16 (counting from
+// the start of SBI1).
+
+// Macros for driving an output high
+#define SBI1 "sbi %10, %11\n"   // happens on cycle 0
+#define SBI2 "sbi %12, %13\n"   // happens on cycle 2
+#define SBI3 "sbi %14, %15\n"   // happens on cycle 4
+
+// Macros for driving an output low
+#define CBI1 "cbi %10, %11\n"
+#define CBI2 "cbi %12, %13\n"
+#define CBI3 "cbi %14, %15\n"
+
+#define ROL1 "rol %3\n"
+#define ROL2 "rol %4\n"
+#define ROL3 "rol %5\n"
+#define HOLD "nop\n" "nop\n"   // takes as long as a CBI but leaves the output high
+#define DEC  "dec %6\n"
+#define DONE "ret\n"
+
+// Sends one bit on all three strips.  A, B and C are CBI1, CBI2 and CBI3 for
+// strips that are sending a 0, or HOLD for strips that are sending a 1.
+#define SEND_BITS(A, B, C) \
+        SBI1 SBI2 SBI3    /* cycle 0 to 5   */ \
+        A B C             /* cycle 6 to 11  */ \
+        CBI1 CBI2 CBI3    /* cycle 12 to 17 */ \
+        "rjmp bit_done\n" /* cycle 18, 19   */
+
+        "bit_done:\n"
+        DEC
+        "brne bxxx\n"
+        DONE
+
+        // send_led_strip_byte subroutine:  Sends a byte to the LED strip.
+        "send_led_strip_byte%=:\n"
+        "ldi %6, 8\n"          // set up the bit counter
+
+        "bxxx:\n"
+        ROL1 "brcs b1xx\n"
+        ROL2 "brcs b01x\n"
+        ROL3 "brcs b001\n"
+        "b000:\n" SEND_BITS(CBI1, CBI2, CBI3)
+        "b001:\n" SEND_BITS(CBI1, CBI2, HOLD)
+        "b01x:\n" ROL3 "brcs b011\n"
+        "b010:\n" SEND_BITS(CBI1, HOLD, CBI3)
+        "b011:\n" SEND_BITS(CBI1, HOLD, HOLD)
+        "b1xx:\n" ROL2 "brcs b11x\n"
+        ROL3 "brcs b101\n"
+        "b100:\n" SEND_BITS(HOLD, CBI2, CBI3)
+        "b101:\n" SEND_BITS(HOLD, CBI2, HOLD)
+        "b11x:\n" ROL3 "brcs b111\n"
+        "b110:\n" SEND_BITS(HOLD, HOLD, CBI3)
+        "b111:\n" SEND_BITS(HOLD, HOLD, HOLD)
+
+#undef SEND_BITS
+#undef SBI1
+#undef SBI2
+#undef SBI3
+#undef CBI1
+#undef CBI2
+#undef CBI3
+#undef ROL1
+#undef ROL2
+#undef ROL3
+#undef HOLD
+#undef DEC
+#undef DONE
+#else
+#error "Unsupported F_CPU"
+#endif
 
         "led_strip_asm_end%=: "
         : "=e" (colors1),
@@ -243,55 +328,18 @@ void __attribute__((noinline)) led_strip_write3(rgb_color * colors1, rgb_color *
           "I" (LED_STRIP3_PIN)                  // %15 is a pin number
     );
 
+#if LED_STRIP_CURRENT_LIMIT
+    colors1 = next1;
+    colors2 = next2;
+    colors3 = next3;
+#endif
+
     // Uncomment the line below to temporarily enable interrupts between each color.
     //sei(); asm volatile("nop\n"); cli();
   }
-  sei();          // Re-enable interrupts now that we are done.
-  _delay_us(80);  // Send the reset signal.
-}
+  LED_STRIP_END();
 
-#define LED_COUNT 60
-rgb_color colors1[LED_COUNT], colors2[LED_COUNT], colors3[LED_COUNT];
-
-int main()
-{
-  unsigned int time = 0;
-
-  while(1)
-  {
-    unsigned char x;
-    unsigned int i;
-
-    // Dislay pretty patterns on most of the LEDs
-    for(i = 0; i < LED_COUNT; i++)
-    {
-      x = (time >> 2) - 8*i;
-      colors1[i] = (rgb_color){ x, 255 - x, x };
-
-      x = (time >> 2) - 50*i;
-      if (x > 127){ x = 255 - x; }
-      x = (x*x) >> 8;
-      colors2[i] = (rgb_color){ 0, 2*x, x };
-
-      x = (time >> 2) - 30*i;
-      if (x > 127){ x = 255 - x; }
-      colors3[i] = (rgb_color){ (x*x) >> 8, 0, ((128-x)*(128-x)) >> 8};
-    }
-
-    // Display a test pattern on the first LEDs that helps us debug the code.
-    x = (time >> 7 & 7);
-    for (i = 0; i < 4; i++)
-    {
-      colors1[i] = (x & 1) ? (rgb_color){ 0xFF, 0xFF, 0xFF } : (rgb_color){ 0x00, 0x00, 0x00 };
-      colors2[i] = (x & 2) ? (rgb_color){ 0xFF, 0xFF, 0xFF } : (rgb_color){ 0x00, 0x00, 0x00 };
-      colors3[i] = (x & 4) ? (rgb_color){ 0xFF, 0xFF, 0xFF } : (rgb_color){ 0x00, 0x00, 0x00 };
-    }
-    colors1[4] = colors2[4] = colors3[4] = (rgb_color){ (x << 5), 0, 0 };
-
-
-    led_strip_write3(colors1, colors2, colors3, LED_COUNT);
-
-    _delay_ms(20);
-    time += 20;
-  }
+#if LED_STRIP_CURRENT_LIMIT
+  led_strip_scale = led_strip_next_scale(total);
+#endif
 }
@@ -0,0 +1,68 @@
+// This is an example program for the LED strip library in led_strip.h.
+//
+// It displays moving patterns on one, two, or three LED strips.  To switch
+// between led_strip_write, led_strip_write2, and led_strip_write3, change
+// LED_STRIP_DEMO_STRIPS below; none of the library files need to change.
+// Whether led_strip_write uses led_strip.c or led_strip_ds.c is chosen with
+// LED_STRIP_BACKEND in the Makefile.
+
+// This line specifies how many LED strips to drive.
+#ifndef LED_STRIP_DEMO_STRIPS
+#define LED_STRIP_DEMO_STRIPS 1
+#endif
+
+#include <avr/io.h>
+#include <util/delay.h>
+#include <stdint.h>
+#include "led_strip.h"
+
+#define LED_COUNT 60
+rgb_color colors1[LED_COUNT];
+#if LED_STRIP_DEMO_STRIPS >= 2
+rgb_color colors2[LED_COUNT];
+#endif
+#if LED_STRIP_DEMO_STRIPS >= 3
+rgb_color colors3[LED_COUNT];
+#endif
+
+int main()
+{
+  uint16_t time = 0;
+  while (1)
+  {
+    uint8_t x;
+
+    // Display pretty patterns on most of the LEDs.
+    for (uint16_t i = 0; i < LED_COUNT; i++)
+    {
+      x = (time >> 2) - 8 * i;
+      colors1[i] = (rgb_color){ x, 255 - x, x };
+
+#if LED_STRIP_DEMO_STRIPS >= 2
+      x = (time >> 2) - 50 * i;
+      if (x > 127) { x = 255 - x; }
+      x = (x * x) >> 8;
+      colors2[i] = (rgb_color){ 0, 2 * x, x };
+#endif
+
+#if LED_STRIP_DEMO_STRIPS >= 3
+      x = (time >> 2) - 30 * i;
+      if (x > 127) { x = 255 - x; }
+      colors3[i] = (rgb_color){ (x * x) >> 8, 0, ((128 - x) * (128 - x)) >> 8 };
+#endif
+    }
+
+#if LED_STRIP_DEMO_STRIPS == 1
+    led_strip_write(colors1, LED_COUNT);
+#elif LED_STRIP_DEMO_STRIPS == 2
+    led_strip_write2(colors1, colors2, LED_COUNT);
+#elif LED_STRIP_DEMO_STRIPS == 3
+    led_strip_write3(colors1, colors2, colors3, LED_COUNT);
+#else
+#error "Unsupported LED_STRIP_DEMO_STRIPS"
+#endif
+
+    _delay_ms(20);
+    time += 20;
+  }
+}
@@ -0,0 +1,32 @@
+// This is the reference encoder for the LED strip library in led_strip.h.
+//
+// It is plain C with no AVR-specific code, so it can also be compiled on your
+// computer (see "make led_strip_host.a") to check what the AVR code sends, for
+// example by decoding a logic analyzer capture or a simulation of the AVR and
+// comparing the result with led_strip_encode.
+
+#include <stdint.h>
+#include "led_strip.h"
+
+uint16_t led_strip_next_scale(uint32_t total)
+{
+  uint32_t current = total * LED_STRIP_CHANNEL_CURRENT / 255;  // mA
+  if (LED_STRIP_CURRENT_LIMIT == 0 || current <= LED_STRIP_CURRENT_LIMIT)
+  {
+    return 256;
+  }
+  return (uint32_t)LED_STRIP_CURRENT_LIMIT * 256 / current;
+}
+
+void led_strip_encode(const rgb_color * colors, uint16_t count, uint16_t scale, uint8_t * bytes)
+{
+  while (count--)
+  {
+    rgb_color color = led_strip_scale_color(colors++, scale);
+
+    // The LEDs expect green, then red, then blue.
+    *bytes++ = color.green;
+    *bytes++ = color.red;
+    *bytes++ = color.blue;
+  }
+}
@@ -0,0 +1,122 @@
+// This is a program for your computer (not the AVR) that packs an animation
+// into an image for the SPI flash chip used by led_strip_player.c.
+//
+// It reads raw 24-bit RGB frames from the standard input, with one
+// red, green, and blue byte for each LED, and writes the image to the standard
+// output.  For example, to convert a video that is LED_COUNT pixels wide and
+// 1 pixel tall:
+//
+//   ffmpeg -i show.mp4 -f rawvideo -pix_fmt rgb24 - | ./led_strip_pack 60 20 > show.bin
+//
+// Build it with "make led_strip_pack".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// The image is addressed with the 24-bit addresses of the Read Data command.
+#define FLASH_SIZE_MAX 0x1000000UL
+
+#define ANIMATION_HEADER_SIZE 8
+
+static void write_u16(uint8_t * p, uint16_t value)
+{
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+int main(int argc, char ** argv)
+{
+  if (argc != 3)
+  {
+    fprintf(stderr, "usage: %s LED_COUNT FRAME_TIME_MS < frames.rgb > image.bin\n", argv[0]);
+    return 1;
+  }
+
+#ifdef _WIN32
+  // The frames and the image are binary, so stop Windows from translating
+  // line endings on the standard input and output.
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+  unsigned long led_count = strtoul(argv[1], NULL, 0);
+  unsigned long frame_time = strtoul(argv[2], NULL, 0);
+  if (led_count == 0 || led_count > 0xFFFF)
+  {
+    fprintf(stderr, "error: LED_COUNT must be between 1 and 65535\n");
+    return 1;
+  }
+  if (frame_time > 0xFFFF)
+  {
+    fprintf(stderr, "error: FRAME_TIME_MS must be at most 65535\n");
+    return 1;
+  }
+
+  // The whole image is built in memory so that the header, which needs the
+  // frame count, can be written first.
+  unsigned long frame_size = led_count * 3;
+  unsigned long image_size = ANIMATION_HEADER_SIZE;
+  uint8_t * image = malloc(FLASH_SIZE_MAX);
+  if (image == NULL)
+  {
+    fprintf(stderr, "error: out of memory\n");
+    return 1;
+  }
+
+  unsigned long frame_count = 0;
+  while (1)
+  {
+    if (frame_count == 0xFFFF || image_size + frame_size > FLASH_SIZE_MAX)
+    {
+      if (getchar() == EOF)
+      {
+        break;
+      }
+      fprintf(stderr, "error: too many frames\n");
+      return 1;
+    }
+
+    // The frames are stored in the same order as the rgb_color struct.
+    size_t size = fread(image + image_size, 1, frame_size, stdin);
+    if (size == 0)
+    {
+      break;
+    }
+    if (size != frame_size)
+    {
+      fprintf(stderr, "error: input ends in the middle of frame %lu\n", frame_count);
+      return 1;
+    }
+    image_size += frame_size;
+    frame_count++;
+  }
+
+  if (ferror(stdin))
+  {
+    perror("error: reading frames");
+    return 1;
+  }
+  if (frame_count == 0)
+  {
+    fprintf(stderr, "error: no frames\n");
+    return 1;
+  }
+
+  write_u16(image + 0, led_count);
+  write_u16(image + 2, frame_count);
+  write_u16(image + 4, frame_time);
+  write_u16(image + 6, 0);
+  if (fwrite(image, image_size, 1, stdout) != 1 || fflush(stdout) != 0)
+  {
+    perror("error: writing image");
+    return 1;
+  }
+
+  free(image);
+  return 0;
+}
@@ -0,0 +1,216 @@
+// This is AVR code for playing animations stored in an external SPI flash chip
+// on the RGB LED strips from Pololu.
+//
+// The animation is made with led_strip_pack (see led_strip_pack.c) and written
+// to the flash chip starting at address 0.  The strip does not have to fit in
+// RAM: each frame is sent in chunks of LED_STRIP_CHUNK LEDs from one half of a
+// ping-pong buffer while the next chunk is read from the flash into the other
+// half.  The bytes are read in the time the data line is low between two
+// LEDs, three for each LED sent.  The SPI hardware shifts in the first of the
+// three while the LED data is being bit-banged, but the other two are
+// transferred while the line is held low, 16 CPU cycles each, so reading the
+// flash makes each LED take a little longer instead of adding a second
+// blocking step to each frame.
+//
+// Timer1 runs at F_CPU/1024 to time the frames, so it cannot be used for
+// anything else.
+//
+// Each color is sent with led_strip_send_color() from the library, so the LED
+// strip pin, LED_STRIP_TIMING, LED_STRIP_CURRENT_LIMIT and LED_STRIP_BACKEND
+// work the same way as for led_strip_write() (see led_strip.h and the
+// Makefile).
+
+// These lines specify the hardware SPI pins and the flash chip's chip select
+// pin.  The defaults are for the ATmega324P.  On the ATmega328P, SS is PB2,
+// MOSI is PB3, and SCK is PB5.  SS must be an output for the SPI module to
+// stay in master mode, so it is used as the chip select by default.
+#define SPI_DDR        DDRB
+#define SPI_SS_PIN     4
+#define SPI_MOSI_PIN   5
+#define SPI_SCK_PIN    7
+#define FLASH_CS_PORT  PORTB
+#define FLASH_CS_DDR   DDRB
+#define FLASH_CS_PIN   4
+
+// This line specifies how many LEDs are in each half of the ping-pong buffer.
+// The buffer takes 6 bytes of RAM per LED.
+#define LED_STRIP_CHUNK 32
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <stdint.h>
+#include "led_strip.h"
+
+#if F_CPU != 20000000 && F_CPU != 16000000 && F_CPU != 8000000
+#error "Unsupported F_CPU"
+#endif
+
+// The animation image starts with this header, stored little-endian.  It is
+// followed by frame_count frames of led_count rgb_color structs each.
+#define ANIMATION_HEADER_SIZE 8
+typedef struct animation_header
+{
+  uint16_t led_count;
+  uint16_t frame_count;
+  uint16_t frame_time;  // milliseconds from the start of one frame to the start of the next
+  uint16_t reserved;
+} animation_header;
+
+// flash_start_read selects the flash chip and sends it a Read Data (0x03)
+// command, after which the chip sends the bytes at consecutive addresses for
+// as long as it stays selected.  One transfer is always kept in progress, so
+// flash_read_byte usually finds its byte already waiting in SPDR.
+void flash_start_read(uint32_t address)
+{
+  FLASH_CS_PORT &= ~(1 << FLASH_CS_PIN);
+  uint8_t command[4] = { 0x03, address >> 16, address >> 8, address };
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    SPDR = command[i];
+    while (!(SPSR & (1 << SPIF)));
+  }
+  SPDR = 0;
+}
+
+// flash_read_byte returns the next byte from the flash chip and starts
+// the transfer of the byte after it.  A transfer takes 16 CPU cycles.
+static inline uint8_t flash_read_byte()
+{
+  while (!(SPSR & (1 << SPIF)));
+  uint8_t byte = SPDR;
+  SPDR = 0;
+  return byte;
+}
+
+void flash_end_read()
+{
+  while (!(SPSR & (1 << SPIF)));
+  (void)SPDR;
+  FLASH_CS_PORT |= (1 << FLASH_CS_PIN);
+}
+
+void flash_read(void * buffer, uint16_t size)
+{
+  uint8_t * p = buffer;
+  while (size--)
+  {
+    *p++ = flash_read_byte();
+  }
+}
+
+#if LED_STRIP_CURRENT_LIMIT
+uint32_t frame_total;  // sum of all the channels requested in this frame
+#endif
+
+// led_strip_write_chunk sends count colors to the LED strip, and reads
+// next_size bytes from the flash chip into next while it does so.
+// Three bytes are read after each color.  The first one was transferred
+// while the color was being sent, but the other two are transferred while
+// the data line is held low, which keeps it low for about 2 us at 20 MHz.
+// That is much shorter than the reset signal, so consecutive calls continue
+// the same frame.  If next_size is more than three times count, the rest of
+// the bytes are read after the last color.
+// The caller must call LED_STRIP_BEGIN before the first chunk of a frame and
+// LED_STRIP_END after the last one.
+void __attribute__((noinline)) led_strip_write_chunk(rgb_color * colors, uint16_t count,
+  void * next, uint16_t next_size)
+{
+  uint8_t * n = next;
+  while (count--)
+  {
+#if LED_STRIP_CURRENT_LIMIT
+    // Add this color to the total and send a scaled copy of it instead,
+    // the same way led_strip_write does.
+    frame_total += colors->red + colors->green + colors->blue;
+    rgb_color scaled = led_strip_scale_color(colors, led_strip_scale);
+    led_strip_send_color(&scaled);
+#else
+    led_strip_send_color(colors);
+#endif
+    colors++;
+
+    for (uint8_t i = 0; i < 3 && next_size; i++, next_size--)
+    {
+      *n++ = flash_read_byte();
+    }
+  }
+  flash_read(n, next_size);
+}
+
+rgb_color buffer[2][LED_STRIP_CHUNK];
+
+int main()
+{
+  LED_STRIP_OUTPUT(LED_STRIP_PORT, LED_STRIP_DDR, LED_STRIP_PIN);
+
+  // Set up the SPI module as a master running at F_CPU/2.
+  FLASH_CS_PORT |= (1 << FLASH_CS_PIN);
+  FLASH_CS_DDR |= (1 << FLASH_CS_PIN);
+  SPI_DDR |= (1 << SPI_SS_PIN) | (1 << SPI_MOSI_PIN) | (1 << SPI_SCK_PIN);
+  SPCR = (1 << SPE) | (1 << MSTR);
+  SPSR = (1 << SPI2X);
+
+  // Start Timer1 at F_CPU/1024 to time the frames.
+  TCCR1B = (1 << CS12) | (1 << CS10);
+
+  animation_header header;
+  flash_start_read(0);
+  flash_read(&header, sizeof(header));
+  flash_end_read();
+
+  uint16_t first_chunk = header.led_count < LED_STRIP_CHUNK ? header.led_count : LED_STRIP_CHUNK;
+
+  while (1)
+  {
+    // The frames are read with one long Read Data command.  Only the very first
+    // chunk is read while nothing is being sent.
+    flash_start_read(ANIMATION_HEADER_SIZE);
+    flash_read(buffer[0], first_chunk * sizeof(rgb_color));
+    uint8_t half = 0;
+
+    for (uint16_t frame = 0; frame < header.frame_count; frame++)
+    {
+      uint16_t remaining = header.led_count;
+      uint16_t start = TCNT1;
+
+      LED_STRIP_BEGIN();
+      while (remaining)
+      {
+        uint16_t count = remaining < LED_STRIP_CHUNK ? remaining : LED_STRIP_CHUNK;
+        remaining -= count;
+
+        // Prefetch the next chunk of this frame, or the first chunk of the next frame.
+        uint16_t next_count = remaining < LED_STRIP_CHUNK ? remaining : LED_STRIP_CHUNK;
+        if (remaining == 0 && frame + 1 < header.frame_count)
+        {
+          next_count = first_chunk;
+        }
+
+        led_strip_write_chunk(buffer[half], count, buffer[half ^ 1], next_count * sizeof(rgb_color));
+        half ^= 1;
+      }
+      LED_STRIP_END();
+
+#if LED_STRIP_CURRENT_LIMIT
+      led_strip_scale = led_strip_next_scale(frame_total);
+      frame_total = 0;
+#endif
+
+      // Wait for the rest of frame_time.  Timer1 overflows after 3.3 s at
+      // 20 MHz, so the counts are added up as they pass.  That works as long as
+      // sending a frame takes less time than that, which is true even for
+      // 65535 LEDs.
+      uint32_t frame_counts = ((uint32_t)header.frame_time * (F_CPU / 1000) + 1023) / 1024;
+      uint32_t elapsed = 0;
+      while (elapsed < frame_counts)
+      {
+        uint16_t now = TCNT1;
+        elapsed += (uint16_t)(now - start);
+        start = now;
+      }
+    }
+
+    flash_end_read();
+  }
+}
@@ -0,0 +1,346 @@
+// This is a program for your computer (not the AVR) that checks
+// led_strip_player.c against a model of the SPI flash chip.
+//
+// The player is compiled for your computer with the stand-in AVR headers in
+// the host directory, and its main function is renamed to
+// led_strip_player_main.  Every access to an AVR register goes through
+// led_strip_host_io below, which models the SPI module, the flash chip
+// holding an image made by led_strip_pack, and Timer1.
+// led_strip_send_color records each color instead of sending it.  After each
+// frame, the colors are compared with what led_strip_encode gives for the
+// frame in the image, scaled by the current limit if there is one, and the
+// time from the start of one frame to the start of the next is compared with
+// the frame_time in the image.  The animation is played twice, and then the
+// program exits.
+//
+// Time is only counted for sending colors, for register accesses, for the
+// SPI transfers, and for the delays, so the time taken by the rest of the C
+// code is not checked.
+//
+// Build and run it with "make check", which also makes the images it plays.
+// It can also write the frames for a test image:
+//
+//   ./led_strip_player_sim frames LED_COUNT FRAME_COUNT | ./led_strip_pack LED_COUNT FRAME_TIME_MS > image.bin
+//   ./led_strip_player_sim image.bin
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include "led_strip.h"
+
+// These lines must match the chip select pin in led_strip_player.c.
+#define FLASH_CS_PORT_ADDRESS 0x25
+#define FLASH_CS_PIN 4
+
+#define ANIMATION_HEADER_SIZE 8
+#define SIM_PASSES 2
+
+#define SPSR_ADDRESS   0x4D
+#define SPDR_ADDRESS   0x4E
+#define TCCR1B_ADDRESS 0x81
+#define TCNT1_ADDRESS  0x84
+
+int led_strip_player_main(void);
+
+#if LED_STRIP_CURRENT_LIMIT
+uint16_t led_strip_scale = 256;
+#endif
+
+static uint16_t io_memory[0x80];  // the registers, 16-bit aligned for TCNT1
+static uint8_t * const io = (uint8_t *)io_memory;
+
+static uint8_t * image;
+static uint32_t image_size;
+static uint16_t led_count, frame_count, frame_time;
+
+static uint64_t now;  // CPU cycles since the start
+
+// The state of the SPI module and the flash chip.
+static uint8_t cs_low;
+static uint8_t transfer_pending;
+static uint64_t transfer_start;
+static uint8_t command_length;
+static uint32_t flash_address;
+
+// The state of the frame being sent.
+static rgb_color * sent;
+static uint16_t sent_count;
+static uint64_t frame_start, spi_wait;
+static uint16_t expected_scale = 256;
+
+// The results.
+static uint32_t frames_checked;
+static uint64_t previous_start;
+static uint64_t period_min = UINT64_MAX, period_max, busy_max, spi_wait_max;
+static int errors;
+
+static void error(const char * message)
+{
+  if (errors < 20)
+  {
+    fprintf(stderr, "led_strip_player_sim: frame %lu: %s\n",
+      (unsigned long)frames_checked, message);
+  }
+  errors++;
+}
+
+static double ms(uint64_t cycles)
+{
+  return cycles * 1000.0 / F_CPU;
+}
+
+// Returns the byte the flash chip sends back while it receives mosi.
+static uint8_t flash_transfer(uint8_t mosi)
+{
+  if (!cs_low)
+  {
+    error("SPI transfer while the flash chip is not selected");
+    return 0xFF;
+  }
+
+  if (command_length == 0 && mosi != 0x03)
+  {
+    error("the command sent to the flash chip is not Read Data");
+  }
+  if (command_length < 4)
+  {
+    if (command_length > 0) { flash_address = flash_address << 8 | mosi; }
+    command_length++;
+    return 0xFF;
+  }
+
+  uint8_t byte = flash_address < image_size ? image[flash_address] : 0xFF;
+  flash_address = (flash_address + 1) & 0xFFFFFF;
+  return byte;
+}
+
+volatile void * led_strip_host_io(uint16_t address)
+{
+  // Each access takes about as long as an lds or sts.
+  now += 2;
+
+  // The chip select is checked on every access, so a change is noticed at the
+  // access after the one that made it.
+  uint8_t cs = !(io[FLASH_CS_PORT_ADDRESS] & (1 << FLASH_CS_PIN));
+  if (cs != cs_low)
+  {
+    cs_low = cs;
+    command_length = 0;
+    transfer_pending = 0;
+  }
+
+  if (address == SPDR_ADDRESS)
+  {
+    // The model cannot tell a read from a write, so any access to SPDR starts a
+    // transfer.  The player always writes SPDR right after reading it.
+    transfer_pending = 1;
+    transfer_start = now;
+    io[SPSR_ADDRESS] &= ~(1 << SPIF);
+  }
+  else if (address == SPSR_ADDRESS && transfer_pending)
+  {
+    // The transfer takes 8 SPI clocks of 2 or 4 CPU cycles.  Polling SPSR
+    // waits for it to finish.
+    uint64_t end = transfer_start + ((io[SPSR_ADDRESS] & (1 << SPI2X)) ? 16 : 32);
+    if (now < end)
+    {
+      spi_wait += end - now;
+      now = end;
+    }
+    io[SPDR_ADDRESS] = flash_transfer(io[SPDR_ADDRESS]);
+    io[SPSR_ADDRESS] |= (1 << SPIF);
+    transfer_pending = 0;
+  }
+  else if (address == TCNT1_ADDRESS || address == TCNT1_ADDRESS + 1)
+  {
+    if ((io[TCCR1B_ADDRESS] & 7) != ((1 << CS12) | (1 << CS10)))
+    {
+      error("Timer1 is read without running at F_CPU/1024");
+    }
+    io_memory[TCNT1_ADDRESS / 2] = now / 1024;
+  }
+
+  return io + address;
+}
+
+void led_strip_send_color(const rgb_color * color)
+{
+  if (!(LED_STRIP_DDR & (1 << LED_STRIP_PIN)))
+  {
+    error("the LED strip pin is not an output");
+  }
+
+  if (sent_count == 0)
+  {
+    frame_start = now;
+    spi_wait = 0;
+  }
+  if (sent_count < led_count)
+  {
+    sent[sent_count] = *color;
+  }
+  sent_count++;
+  now += 24 * LED_STRIP_PERIOD_CYCLES;
+}
+
+static void finish(void)
+{
+  printf("%lu frames of %u LEDs at %lu MHz, frame_time %u ms:\n",
+    (unsigned long)frames_checked, led_count, (unsigned long)(F_CPU / 1000000), frame_time);
+  printf("  sending a frame took up to %.3f ms, %.3f ms of it reading the flash while the line was low\n",
+    ms(busy_max), ms(spi_wait_max));
+  if (period_max)
+  {
+    printf("  frame period %.3f-%.3f ms\n", ms(period_min), ms(period_max));
+  }
+  if (errors)
+  {
+    printf("%d errors.\n", errors);
+    exit(1);
+  }
+  printf("All checks passed.\n");
+  exit(0);
+}
+
+// Checks the frame that was just sent, at the start of the reset signal.
+static void check_frame(void)
+{
+  uint32_t frame = frames_checked % frame_count;
+  uint32_t frame_size = (uint32_t)led_count * 3;
+  const rgb_color * colors = (const rgb_color *)(image + ANIMATION_HEADER_SIZE + frame * frame_size);
+
+  if (sent_count != led_count)
+  {
+    error("the wrong number of colors was sent");
+  }
+  else
+  {
+    uint8_t * expected = malloc(frame_size);
+    uint8_t * actual = malloc(frame_size);
+    led_strip_encode(colors, led_count, expected_scale, expected);
+    led_strip_encode(sent, led_count, 256, actual);
+    for (uint32_t i = 0; i < frame_size; i++)
+    {
+      if (expected[i] != actual[i])
+      {
+        char message[100];
+        snprintf(message, sizeof(message), "LED %lu was sent 0x%02X instead of 0x%02X",
+          (unsigned long)(i / 3), actual[i], expected[i]);
+        error(message);
+        break;
+      }
+    }
+    free(expected);
+    free(actual);
+  }
+
+  uint32_t total = 0;
+  for (uint16_t i = 0; i < led_count; i++)
+  {
+    total += colors[i].red + colors[i].green + colors[i].blue;
+  }
+  expected_scale = led_strip_next_scale(total);
+
+  // The first frame of each pass starts after the first chunk of the image is
+  // read again, so only the frames within a pass are timed.  Timer1 counts
+  // 1024 cycles at a time, so the period can be off by one count.
+  uint64_t busy = now + 80 * (F_CPU / 1000000) - frame_start;
+  if (busy > busy_max) { busy_max = busy; }
+  if (spi_wait > spi_wait_max) { spi_wait_max = spi_wait; }
+  if (frame != 0)
+  {
+    uint64_t period = frame_start - previous_start;
+    uint64_t frame_cycles = (uint64_t)frame_time * (F_CPU / 1000);
+    uint64_t longest = (frame_cycles > busy ? frame_cycles : busy) + 1024 + 64;
+    if (period + 1024 < frame_cycles || period > longest)
+    {
+      char message[100];
+      snprintf(message, sizeof(message), "the frame period is %.3f ms", ms(period));
+      error(message);
+    }
+    if (period < period_min) { period_min = period; }
+    if (period > period_max) { period_max = period; }
+  }
+  previous_start = frame_start;
+
+  sent_count = 0;
+  frames_checked++;
+  if (frames_checked == (uint32_t)frame_count * SIM_PASSES)
+  {
+    finish();
+  }
+}
+
+void _delay_us(double us)
+{
+  // A delay long enough to be a reset signal ends the frame.
+  if (us >= 50 && sent_count)
+  {
+    check_frame();
+  }
+  now += us * (F_CPU / 1000000);
+}
+
+void _delay_ms(double delay)
+{
+  now += delay * (F_CPU / 1000);
+}
+
+// Writes frame_count frames of led_count random colors to the standard
+// output, for led_strip_pack.  The first frame is all white, so that a current
+// limit has something to limit.
+static int write_frames(unsigned long count, unsigned long frames)
+{
+  uint32_t random = 0x12345678;
+  for (unsigned long i = 0; i < count * frames * 3; i++)
+  {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    putchar(i < count * 3 ? 0xFF : random & 0xFF);
+  }
+  return fflush(stdout) != 0;
+}
+
+int main(int argc, char ** argv)
+{
+  if (argc == 4 && strcmp(argv[1], "frames") == 0)
+  {
+    return write_frames(strtoul(argv[2], NULL, 0), strtoul(argv[3], NULL, 0));
+  }
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: %s IMAGE\n       %s frames LED_COUNT FRAME_COUNT\n", argv[0], argv[0]);
+    return 1;
+  }
+
+  FILE * file = fopen(argv[1], "rb");
+  if (file == NULL)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  image = malloc(0x1000000);
+  image_size = fread(image, 1, 0x1000000, file);
+  fclose(file);
+  if (image_size < ANIMATION_HEADER_SIZE)
+  {
+    fprintf(stderr, "led_strip_player_sim: %s is not an animation image\n", argv[1]);
+    return 1;
+  }
+
+  led_count = image[0] | image[1] << 8;
+  frame_count = image[2] | image[3] << 8;
+  frame_time = image[4] | image[5] << 8;
+  if (image_size != ANIMATION_HEADER_SIZE + (uint32_t)led_count * 3 * frame_count)
+  {
+    fprintf(stderr, "led_strip_player_sim: the size of %s does not match its header\n", argv[1]);
+    return 1;
+  }
+  sent = malloc(led_count * sizeof(rgb_color));
+
+  led_strip_player_main();
+  return 1;
+}
@@ -0,0 +1,1112 @@
+// This is a program for your computer (not the AVR) that checks the assembly
+// in the LED strip writers with a cycle-counting simulation.
+//
+// Each writer is run through the C preprocessor at every supported F_CPU, and
+// led_strip.c and led_strip_ds.c are also run with every LED_STRIP_TIMING
+// profile.  This program finds the asm statement in the writer, runs it for a
+// series of random colors while counting the cycles taken by each
+// instruction, and records when each LED strip's pin changes.  Each pin's
+// waveform is decoded the way the LEDs decode it and compared with the bytes
+// from led_strip_encode, and the pulse widths, the periods, and the time taken
+// by each color are printed.  Each pulse must be within the shortest and
+// longest allowed by the timing profile, and the line must stay low after each
+// bit for at least the time it gives (the multi-strip writers are held to the
+// default profile), and the multi-strip writers must take less time per
+// strip than led_strip_write does at the same F_CPU.
+//
+// Only the instructions used by the writers are simulated, with the cycle
+// counts of the ATmega324P and other AVRs with up to 128 KB of flash.  The C
+// code around the asm statement is not simulated, so the time between two
+// colors is not checked.
+//
+// Build and run it with "make check", which runs it as:
+//
+//   ./led_strip_sim $(HOSTCC) $(LED_STRIP_FLAGS)
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "led_strip.h"
+
+// This line specifies how many colors are sent to each LED strip.
+#define SIM_LED_COUNT 64
+
+#define SIM_MAX_LANES        3
+#define SIM_MAX_OPERANDS     30
+#define SIM_MAX_REGISTERS    32
+#define SIM_MAX_INSTRUCTIONS 4096
+#define SIM_MAX_LABELS       256
+#define SIM_MAX_STEPS        100000
+
+typedef struct writer
+{
+  const char * file;
+  const char * function;
+  uint8_t lanes;
+  uint8_t uses_timing;    // 1 if the writer uses LED_STRIP_TIMING
+  uint8_t supports_8mhz;
+} writer;
+
+static const writer writers[] = {
+  { "led_strip.c",    "led_strip_send_color", 1, 1, 1 },
+  { "led_strip_ds.c", "led_strip_send_color", 1, 1, 1 },
+  { "led_strip2.c",   "led_strip_write2",     2, 0, 1 },
+  { "led_strip3.c",   "led_strip_write3",     3, 0, 0 },
+};
+
+static const uint32_t clocks[] = { 20000000, 16000000, 8000000 };
+
+static const char * const timings[] = {
+  "WS2812B", "SK6812", "WS2811_LOW_SPEED", "TM1804", "TM1804_LOW_SPEED", "FAST",
+};
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+static char compiler[1024];
+
+static void fail(const char * message, const char * detail)
+{
+  fprintf(stderr, "led_strip_sim: %s%s%s\n", message, detail ? ": " : "", detail ? detail : "");
+  exit(1);
+}
+
+// Runs the C preprocessor on file and returns its output.  F_CPU and
+// LED_STRIP_TIMING are undefined first in case the options passed to this
+// program define them, so that the preprocessor does not warn about
+// redefining them.
+static char * preprocess(const char * file, uint32_t f_cpu, const char * timing)
+{
+  char command[2048];
+  snprintf(command, sizeof(command),
+    "%s -E -P -Ihost -I. -DLED_STRIP_SIM -UF_CPU -ULED_STRIP_TIMING"
+    " -DF_CPU=%luUL -DLED_STRIP_TIMING=LED_STRIP_TIMING_%s %s",
+    compiler, (unsigned long)f_cpu, timing, file);
+
+  FILE * pipe = popen(command, "r");
+  if (pipe == NULL)
+  {
+    fail("could not run the preprocessor", command);
+  }
+
+  size_t size = 0, capacity = 65536;
+  char * text = malloc(capacity);
+  size_t n;
+  while (text && (n = fread(text + size, 1, capacity - size - 1, pipe)) > 0)
+  {
+    size += n;
+    if (capacity - size < 4096)
+    {
+      capacity *= 2;
+      text = realloc(text, capacity);
+    }
+  }
+  if (text == NULL)
+  {
+    fail("out of memory", NULL);
+  }
+  text[size] = 0;
+
+  if (pclose(pipe) != 0)
+  {
+    fail("the preprocessor failed", command);
+  }
+  return text;
+}
+
+//// Constant expressions
+
+// The constant operands of an asm statement and the settings in
+// host/led_strip_sim.h are C expressions by the time they have been through
+// the preprocessor.  This evaluates them.
+
+typedef struct expression
+{
+  const char * p;
+  const char * text;
+} expression;
+
+static long long eval_conditional(expression * e);
+
+static void skip_space(const char ** p)
+{
+  while (isspace((unsigned char)**p)) { (*p)++; }
+}
+
+static int identifier_length(const char * p)
+{
+  int length = 0;
+  if (isalpha((unsigned char)p[0]) || p[0] == '_')
+  {
+    while (isalnum((unsigned char)p[length]) || p[length] == '_') { length++; }
+  }
+  return length;
+}
+
+static int is_word(const char * p, const char * word)
+{
+  int length = identifier_length(p);
+  return length == (int)strlen(word) && memcmp(p, word, length) == 0;
+}
+
+static void expression_error(expression * e)
+{
+  fail("could not evaluate", e->text);
+}
+
+// Returns the number of bits kept by the type name at e->p (0 if there is no
+// limit, -1 if it is not a type name), and skips past it.
+static int eval_type_name(expression * e)
+{
+  static const char * const types[] = {
+    "uint8_t", "int8_t", "char", "uint16_t", "int16_t", "short",
+    "uint32_t", "int32_t", "int", "long", "unsigned", "signed", "volatile", "const",
+  };
+
+  int bits = -1;
+  while (1)
+  {
+    skip_space(&e->p);
+    if (*e->p == '*')
+    {
+      e->p++;
+      bits = 0;
+      continue;
+    }
+
+    size_t i;
+    for (i = 0; i < ARRAY_LENGTH(types); i++)
+    {
+      if (is_word(e->p, types[i])) { break; }
+    }
+    if (i == ARRAY_LENGTH(types)) { return bits; }
+
+    if (bits < 0) { bits = 0; }
+    if (i < 3) { bits = 8; }
+    else if (i < 6 && bits != 8) { bits = 16; }
+    e->p += strlen(types[i]);
+  }
+}
+
+static long long eval_unary(expression * e)
+{
+  skip_space(&e->p);
+  char c = *e->p;
+
+  if (c == '-') { e->p++; return -eval_unary(e); }
+  if (c == '+') { e->p++; return eval_unary(e); }
+  if (c == '~') { e->p++; return ~eval_unary(e); }
+  if (c == '!') { e->p++; return !eval_unary(e); }
+
+  // Registers are already numbers (see host/avr/io.h), so taking the address
+  // of one or dereferencing it does nothing.
+  if (c == '&' || c == '*') { e->p++; return eval_unary(e); }
+
+  if (c == '(')
+  {
+    e->p++;
+    const char * start = e->p;
+    int bits = eval_type_name(e);
+    if (bits >= 0)
+    {
+      skip_space(&e->p);
+      if (*e->p != ')') { expression_error(e); }
+      e->p++;
+      long long value = eval_unary(e);
+      return bits ? value & ((1LL << bits) - 1) : value;
+    }
+
+    e->p = start;
+    long long value = eval_conditional(e);
+    skip_space(&e->p);
+    if (*e->p != ')') { expression_error(e); }
+    e->p++;
+    return value;
+  }
+
+  if (isdigit((unsigned char)c))
+  {
+    char * end;
+    long long value = strtoll(e->p, &end, 0);
+    e->p = end;
+    while (*e->p == 'u' || *e->p == 'U' || *e->p == 'l' || *e->p == 'L') { e->p++; }
+    return value;
+  }
+
+  int length = identifier_length(e->p);
+  if (length)
+  {
+    // A C variable, like portValue in led_strip_ds.c.  These are taken to be
+    // 0, which is the value of every register when the simulation starts.
+    e->p += length;
+    return 0;
+  }
+
+  expression_error(e);
+  return 0;
+}
+
+typedef struct binary_operator
+{
+  const char * text;
+  int precedence;
+} binary_operator;
+
+// Operators that start with the same character as a shorter one come first.
+static const binary_operator binary_operators[] = {
+  { "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 }, { "<=", 7 }, { ">=", 7 },
+  { "<<", 8 }, { ">>", 8 }, { "|", 3 }, { "^", 4 }, { "&", 5 }, { "<", 7 },
+  { ">", 7 }, { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 },
+};
+
+static long long eval_binary(expression * e, int min_precedence)
+{
+  long long left = eval_unary(e);
+  while (1)
+  {
+    skip_space(&e->p);
+    const binary_operator * op = NULL;
+    for (size_t i = 0; i < ARRAY_LENGTH(binary_operators); i++)
+    {
+      size_t length = strlen(binary_operators[i].text);
+      if (strncmp(e->p, binary_operators[i].text, length) == 0)
+      {
+        op = &binary_operators[i];
+        break;
+      }
+    }
+    if (op == NULL || op->precedence < min_precedence) { return left; }
+
+    e->p += strlen(op->text);
+    long long right = eval_binary(e, op->precedence + 1);
+    switch (op->text[0] + (op->text[1] << 8))
+    {
+    case '|' + ('|' << 8): left = left || right; break;
+    case '&' + ('&' << 8): left = left && right; break;
+    case '=' + ('=' << 8): left = left == right; break;
+    case '!' + ('=' << 8): left = left != right; break;
+    case '<' + ('=' << 8): left = left <= right; break;
+    case '>' + ('=' << 8): left = left >= right; break;
+    case '<' + ('<' << 8): left = left << right; break;
+    case '>' + ('>' << 8): left = left >> right; break;
+    case '|': left = left | right; break;
+    case '^': left = left ^ right; break;
+    case '&': left = left & right; break;
+    case '<': left = left < right; break;
+    case '>': left = left > right; break;
+    case '+': left = left + right; break;
+    case '-': left = left - right; break;
+    case '*': left = left * right; break;
+    case '/':
+    case '%':
+      if (right == 0) { expression_error(e); }
+      left = op->text[0] == '/' ? left / right : left % right;
+      break;
+    }
+  }
+}
+
+static long long eval_conditional(expression * e)
+{
+  long long condition = eval_binary(e, 1);
+  skip_space(&e->p);
+  if (*e->p != '?') { return condition; }
+  e->p++;
+  long long a = eval_conditional(e);
+  skip_space(&e->p);
+  if (*e->p != ':') { expression_error(e); }
+  e->p++;
+  long long b = eval_conditional(e);
+  return condition ? a : b;
+}
+
+// Evaluates the expression from start to end.
+static long long eval(const char * start, const char * end)
+{
+  size_t length = end - start;
+  char * text = malloc(length + 1);
+  if (text == NULL) { fail("out of memory", NULL); }
+  memcpy(text, start, length);
+  text[length] = 0;
+
+  expression e = { text, text };
+  long long value = eval_conditional(&e);
+  skip_space(&e.p);
+  if (*e.p) { expression_error(&e); }
+  free(text);
+  return value;
+}
+
+// Returns a pointer to the parenthesis that matches the one at p.
+static const char * matching_parenthesis(const char * p)
+{
+  int depth = 0;
+  for (; *p; p++)
+  {
+    if (*p == '"')
+    {
+      for (p++; *p && *p != '"'; p++)
+      {
+        if (*p == '\\' && p[1]) { p++; }
+      }
+    }
+    else if (*p == '(') { depth++; }
+    else if (*p == ')' && --depth == 0) { return p; }
+  }
+  fail("unbalanced parentheses", NULL);
+  return NULL;
+}
+
+// Evaluates the comma-separated expressions in the parentheses at p.
+static int eval_list(const char * p, long long * values, int max)
+{
+  const char * end = matching_parenthesis(p);
+  int count = 0;
+  p++;
+  while (p < end)
+  {
+    const char * start = p;
+    int depth = 0;
+    while (p < end && !(depth == 0 && *p == ','))
+    {
+      if (*p == '(') { depth++; }
+      if (*p == ')') { depth--; }
+      p++;
+    }
+    if (count == max) { fail("too many values", NULL); }
+    values[count++] = eval(start, p);
+    if (p < end) { p++; }
+  }
+  return count;
+}
+
+//// Settings
+
+typedef struct settings
+{
+  long long pulse_ns[2];  // nominal 0 pulse and 1 pulse
+  long long low_min_ns[2];  // shortest low time after a 0 and after a 1
+  long long pulse_min_ns[2], pulse_max_ns[2];  // allowed 0 pulse and 1 pulse
+  uint16_t port[SIM_MAX_LANES];
+  uint8_t pin[SIM_MAX_LANES];
+} settings;
+
+static void read_settings(const writer * w, uint32_t f_cpu, const char * timing, settings * s)
+{
+  char * text = preprocess("host/led_strip_sim.h", f_cpu, timing);
+  const char * p = strstr(text, "led_strip_sim_settings");
+  if (p == NULL) { fail("no settings in host/led_strip_sim.h", NULL); }
+  p = strchr(p, '(');
+
+  long long values[16];
+  if (eval_list(p, values, 16) != 16) { fail("wrong number of settings in host/led_strip_sim.h", NULL); }
+
+  s->pulse_ns[0] = values[0];
+  s->pulse_ns[1] = values[1];
+  s->low_min_ns[0] = values[2];
+  s->low_min_ns[1] = values[3];
+  for (int value = 0; value < 2; value++)
+  {
+    s->pulse_min_ns[value] = values[4 + 2 * value];
+    s->pulse_max_ns[value] = values[5 + 2 * value];
+  }
+  for (int lane = 0; lane < SIM_MAX_LANES; lane++)
+  {
+    // led_strip_write uses LED_STRIP_PORT, the others LED_STRIP1_PORT and so on.
+    int i = w->lanes == 1 ? 8 : 10 + 2 * lane;
+    s->port[lane] = values[i];
+    s->pin[lane] = values[i + 1];
+  }
+  free(text);
+}
+
+//// Parsing the asm statement
+
+typedef struct operand
+{
+  char kind;        // 'c' for a constant, 'r' for a register, 'p' for a pointer
+  long long value;  // the constant, or the starting value of a register
+  int lane;         // the strip whose colors a pointer points to
+} operand;
+
+typedef struct statement
+{
+  char op[8];
+  char args[2][32];
+  int arg_count;
+  int words;
+  uint16_t address;  // in words
+} statement;
+
+typedef struct label
+{
+  char name[64];
+  int index;
+} label;
+
+typedef struct program
+{
+  statement statements[SIM_MAX_INSTRUCTIONS];
+  int count;
+  label labels[SIM_MAX_LABELS];
+  int label_count;
+  operand operands[SIM_MAX_OPERANDS];
+  int operand_count;
+} program;
+
+// Reads the string literals at *p into out, and returns the number of bytes.
+static size_t read_strings(const char ** p, char * out, size_t max)
+{
+  size_t size = 0;
+  while (1)
+  {
+    skip_space(p);
+    if (**p != '"') { break; }
+    for ((*p)++; **p != '"'; (*p)++)
+    {
+      char c = **p;
+      if (c == 0) { fail("unterminated string", NULL); }
+      if (c == '\\')
+      {
+        c = *++*p;
+        if (c == 'n') { c = '\n'; }
+        else if (c == 't') { c = '\t'; }
+      }
+      if (size + 1 >= max) { fail("asm statement too long", NULL); }
+      out[size++] = c;
+    }
+    (*p)++;
+  }
+  out[size] = 0;
+  return size;
+}
+
+// Reads a list of operands such as '"=b" (colors), "I" (LED_STRIP_PIN)'.
+static void read_operands(const char ** p, program * prog, int output)
+{
+  while (1)
+  {
+    skip_space(p);
+    if (**p != '"') { return; }
+
+    char constraint[16];
+    read_strings(p, constraint, sizeof(constraint));
+    skip_space(p);
+    if (**p != '(') { fail("bad asm operand", constraint); }
+    const char * end = matching_parenthesis(*p);
+
+    if (prog->operand_count == SIM_MAX_OPERANDS) { fail("too many asm operands", NULL); }
+    operand * o = &prog->operands[prog->operand_count++];
+    const char * c = constraint + strspn(constraint, "=+&");
+    if (isdigit((unsigned char)*c))
+    {
+      // This input is the same as an output.
+      int tied = atoi(c);
+      if (tied >= prog->operand_count - 1) { fail("bad asm operand", constraint); }
+      *o = prog->operands[tied];
+    }
+    else if (strpbrk(c, "bexyz"))
+    {
+      o->kind = 'p';
+      o->lane = 0;
+      for (operand * other = prog->operands; other < o; other++)
+      {
+        if (other->kind == 'p') { o->lane++; }
+      }
+      if (o->lane >= SIM_MAX_LANES) { fail("too many pointers", NULL); }
+    }
+    else if (strpbrk(c, "rdla"))
+    {
+      o->kind = 'r';
+      o->value = output ? 0 : eval(*p + 1, end) & 0xFF;
+    }
+    else
+    {
+      o->kind = 'c';
+      o->value = eval(*p + 1, end);
+    }
+
+    *p = end + 1;
+    skip_space(p);
+    if (**p != ',') { return; }
+    (*p)++;
+  }
+}
+
+// Replaces the operands in the template with their values or register names.
+static void substitute(const program * prog, const char * template, char * out, size_t max)
+{
+  size_t size = 0;
+  for (const char * p = template; *p; p++)
+  {
+    char text[32];
+    if (*p != '%')
+    {
+      text[0] = *p;
+      text[1] = 0;
+    }
+    else if (p[1] == '%' || p[1] == '=')
+    {
+      // "%=" makes labels unique.  Only one asm statement is simulated at a
+      // time, so it is dropped.
+      text[0] = *++p == '%' ? '%' : 0;
+      text[1] = 0;
+    }
+    else
+    {
+      int address = p[1] == 'a';
+      if (address) { p++; }
+      if (!isdigit((unsigned char)p[1])) { fail("bad operand in asm statement", p); }
+      int i = strtol(p + 1, (char **)&p, 10);
+      p--;
+      if (i >= prog->operand_count) { fail("bad operand in asm statement", NULL); }
+
+      const operand * o = &prog->operands[i];
+      if (address != (o->kind == 'p')) { fail("bad operand in asm statement", NULL); }
+      if (o->kind == 'p') { snprintf(text, sizeof(text), "p%d", o->lane); }
+      else if (o->kind == 'r') { snprintf(text, sizeof(text), "r%d", i); }
+      else { snprintf(text, sizeof(text), "%lld", o->value); }
+    }
+
+    size_t length = strlen(text);
+    if (size + length >= max) { fail("asm statement too long", NULL); }
+    memcpy(out + size, text, length);
+    size += length;
+  }
+  out[size] = 0;
+}
+
+// Adds the statements in lines[0] to lines[count - 1] to the program,
+// repeating the ones between ".rept" and ".endr".
+static void add_lines(program * prog, char ** lines, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    char * line = lines[i];
+
+    // Labels start the line.  Local labels, which are numbers, can be used
+    // more than once.
+    int length;
+    while (((length = identifier_length(line)) || (length = strspn(line, "0123456789"))) &&
+      line[length] == ':')
+    {
+      if (prog->label_count == SIM_MAX_LABELS) { fail("too many labels", NULL); }
+      label * l = &prog->labels[prog->label_count++];
+      snprintf(l->name, sizeof(l->name), "%.*s", length, line);
+      l->index = prog->count;
+      line += length + 1;
+      skip_space((const char **)&line);
+    }
+    if (*line == 0) { continue; }
+
+    if (strncmp(line, ".rept", 5) == 0)
+    {
+      int repeat = atoi(line + 5);
+      int end, depth = 1;
+      for (end = i + 1; end < count; end++)
+      {
+        if (strncmp(lines[end], ".rept", 5) == 0) { depth++; }
+        if (strncmp(lines[end], ".endr", 5) == 0 && --depth == 0) { break; }
+      }
+      if (end == count) { fail(".rept without .endr", NULL); }
+      for (int r = 0; r < repeat; r++)
+      {
+        add_lines(prog, lines + i + 1, end - i - 1);
+      }
+      i = end;
+      continue;
+    }
+
+    if (prog->count == SIM_MAX_INSTRUCTIONS) { fail("too many instructions", NULL); }
+    statement * s = &prog->statements[prog->count++];
+    memset(s, 0, sizeof(*s));
+    char * args = line + strcspn(line, " \t");
+    snprintf(s->op, sizeof(s->op), "%.*s", (int)(args - line), line);
+    while (*args)
+    {
+      skip_space((const char **)&args);
+      size_t arg_length = strcspn(args, ",");
+      while (arg_length && isspace((unsigned char)args[arg_length - 1])) { arg_length--; }
+      if (s->arg_count == 2) { fail("too many arguments", line); }
+      snprintf(s->args[s->arg_count++], sizeof(s->args[0]), "%.*s", (int)arg_length, args);
+      args += strcspn(args, ",");
+      if (*args == ',') { args++; }
+    }
+    s->words = !strcmp(s->op, "sts") || !strcmp(s->op, "lds") ||
+      !strcmp(s->op, "call") || !strcmp(s->op, "jmp") ? 2 : 1;
+  }
+}
+
+// Finds the first asm statement in the definition of function and turns it
+// into a program.
+static void parse(const char * text, const char * function, program * prog)
+{
+  const char * p = text;
+  while (1)
+  {
+    p = strstr(p, function);
+    if (p == NULL) { fail("function not found", function); }
+    int length = identifier_length(p);
+    if ((p == text || !(isalnum((unsigned char)p[-1]) || p[-1] == '_')) && length == (int)strlen(function))
+    {
+      const char * q = p + length;
+      skip_space(&q);
+      if (*q == '(')
+      {
+        q = matching_parenthesis(q) + 1;
+        skip_space(&q);
+        if (*q == '{') { p = q; break; }
+      }
+    }
+    p += length ? length : 1;
+  }
+
+  while (!(is_word(p, "asm") || is_word(p, "__asm__")) || isalnum((unsigned char)p[-1]) || p[-1] == '_')
+  {
+    if (*p == 0) { fail("no asm statement in", function); }
+    p++;
+  }
+  p += identifier_length(p);
+  skip_space(&p);
+  if (is_word(p, "volatile") || is_word(p, "__volatile__")) { p += identifier_length(p); }
+  skip_space(&p);
+  if (*p++ != '(') { fail("bad asm statement in", function); }
+
+  static char template[65536], substituted[65536];
+  read_strings(&p, template, sizeof(template));
+
+  memset(prog, 0, sizeof(*prog));
+  for (int output = 1; output >= 0; output--)
+  {
+    skip_space(&p);
+    if (*p != ':') { break; }
+    p++;
+    read_operands(&p, prog, output);
+  }
+
+  substitute(prog, template, substituted, sizeof(substituted));
+
+  static char * lines[SIM_MAX_INSTRUCTIONS];
+  int count = 0;
+  for (char * line = strtok(substituted, "\n"); line; line = strtok(NULL, "\n"))
+  {
+    skip_space((const char **)&line);
+    if (count == SIM_MAX_INSTRUCTIONS) { fail("too many lines", NULL); }
+    lines[count++] = line;
+  }
+  add_lines(prog, lines, count);
+
+  uint16_t address = 0;
+  for (int i = 0; i < prog->count; i++)
+  {
+    prog->statements[i].address = address;
+    address += prog->statements[i].words;
+  }
+}
+
+//// Running the program
+
+typedef struct machine
+{
+  uint8_t memory[0x10000];
+  uint16_t pointers[SIM_MAX_LANES];
+  uint8_t registers[SIM_MAX_OPERANDS];
+  uint8_t tmp_reg;
+  uint8_t c, z, t;
+  uint32_t time;
+} machine;
+
+typedef struct edge
+{
+  uint32_t time;
+  uint8_t lane;
+  uint8_t level;
+} edge;
+
+static uint8_t * reg(machine * m, const char * name)
+{
+  if (!strcmp(name, "__tmp_reg__")) { return &m->tmp_reg; }
+  if (name[0] == 'r' && isdigit((unsigned char)name[1]) && atoi(name + 1) < SIM_MAX_OPERANDS)
+  {
+    return &m->registers[atoi(name + 1)];
+  }
+  fail("unknown register", name);
+  return NULL;
+}
+
+static int find_target(const program * prog, int index, const char * target)
+{
+  if (target[0] == '.')
+  {
+    // A relative jump, in bytes from the next instruction.
+    const statement * s = &prog->statements[index];
+    int address = s->address + s->words + atoi(target + 1) / 2;
+    for (int i = 0; i <= prog->count; i++)
+    {
+      int a = i < prog->count ? prog->statements[i].address
+        : prog->statements[i - 1].address + prog->statements[i - 1].words;
+      if (a == address) { return i; }
+    }
+    fail("bad jump target", target);
+  }
+
+  size_t digits = strspn(target, "0123456789");
+  if (digits && (!strcmp(target + digits, "f") || !strcmp(target + digits, "b")))
+  {
+    // A local label: "1f" is the next "1:" and "1b" is the previous one.
+    int forward = target[digits] == 'f';
+    int found = -1;
+    for (int i = 0; i < prog->label_count; i++)
+    {
+      const label * l = &prog->labels[i];
+      if (strlen(l->name) != digits || strncmp(l->name, target, digits)) { continue; }
+      if (forward && l->index > index) { return l->index; }
+      if (!forward && l->index <= index) { found = l->index; }
+    }
+    if (found >= 0) { return found; }
+    fail("unknown label", target);
+  }
+
+  for (int i = 0; i < prog->label_count; i++)
+  {
+    if (!strcmp(prog->labels[i].name, target)) { return prog->labels[i].index; }
+  }
+  fail("unknown label", target);
+  return 0;
+}
+
+// Runs the program once, which sends one color to each strip, and adds an
+// edge to edges each time one of the pins changes.  Returns the number of edges.
+static int run(const program * prog, machine * m, const settings * s, int lanes, edge * edges, int max_edges)
+{
+  int stack[8];
+  int depth = 0;
+  int count = 0;
+  int pc = 0;
+
+  uint8_t levels[SIM_MAX_LANES];
+  for (int lane = 0; lane < lanes; lane++)
+  {
+    levels[lane] = m->memory[s->port[lane]] >> s->pin[lane] & 1;
+  }
+
+  for (int steps = 0; pc < prog->count; steps++)
+  {
+    if (steps == SIM_MAX_STEPS) { fail("the program does not finish", NULL); }
+
+    const statement * st = &prog->statements[pc];
+    const char * op = st->op;
+    const char * a = st->args[0];
+    const char * b = st->args[1];
+    int next = pc + 1;
+
+    if (!strcmp(op, "ld"))
+    {
+      // ld Rd, X / X+ / -X
+      int pre = b[0] == '-';
+      int lane = atoi(b + pre + 1);
+      if (b[pre] != 'p' || lane >= SIM_MAX_LANES) { fail("bad ld", b); }
+      if (pre) { m->pointers[lane]--; }
+      *reg(m, a) = m->memory[m->pointers[lane]];
+      if (b[strlen(b) - 1] == '+') { m->pointers[lane]++; }
+      m->time += 2;
+    }
+    else if (!strcmp(op, "ldi")) { *reg(m, a) = strtol(b, NULL, 0); m->time += 1; }
+    else if (!strcmp(op, "mov")) { *reg(m, a) = *reg(m, b); m->time += 1; }
+    else if (!strcmp(op, "nop")) { m->time += 1; }
+    else if (!strcmp(op, "rol") || !strcmp(op, "lsl"))
+    {
+      uint8_t * r = reg(m, a);
+      uint8_t carry = *r >> 7;
+      *r = *r << 1 | (op[0] == 'r' ? m->c : 0);
+      m->c = carry;
+      m->z = *r == 0;
+      m->time += 1;
+    }
+    else if (!strcmp(op, "dec")) { uint8_t * r = reg(m, a); m->z = --*r == 0; m->time += 1; }
+    else if (!strcmp(op, "bst")) { m->t = *reg(m, a) >> atoi(b) & 1; m->time += 1; }
+    else if (!strcmp(op, "sbi") || !strcmp(op, "cbi"))
+    {
+      uint8_t * r = &m->memory[(strtol(a, NULL, 0) + 0x20) & 0xFFFF];
+      uint8_t mask = 1 << atoi(b);
+      *r = op[0] == 's' ? *r | mask : *r & ~mask;
+      m->time += 2;
+    }
+    else if (!strcmp(op, "sts")) { m->memory[strtol(a, NULL, 0) & 0xFFFF] = *reg(m, b); m->time += 2; }
+    else if (!strcmp(op, "out")) { m->memory[(strtol(a, NULL, 0) + 0x20) & 0xFFFF] = *reg(m, b); m->time += 1; }
+    else if (!strcmp(op, "rjmp")) { next = find_target(prog, pc, a); m->time += 2; }
+    else if (!strcmp(op, "rcall"))
+    {
+      if (depth == ARRAY_LENGTH(stack)) { fail("stack overflow", NULL); }
+      stack[depth++] = next;
+      next = find_target(prog, pc, a);
+      m->time += 3;
+    }
+    else if (!strcmp(op, "ret"))
+    {
+      if (depth == 0) { fail("ret without rcall", NULL); }
+      next = stack[--depth];
+      m->time += 4;
+    }
+    else if (op[0] == 'b' && op[1] == 'r')
+    {
+      int taken;
+      if (!strcmp(op, "brcs")) { taken = m->c; }
+      else if (!strcmp(op, "brcc")) { taken = !m->c; }
+      else if (!strcmp(op, "brts")) { taken = m->t; }
+      else if (!strcmp(op, "brtc")) { taken = !m->t; }
+      else if (!strcmp(op, "breq")) { taken = m->z; }
+      else if (!strcmp(op, "brne")) { taken = !m->z; }
+      else { fail("unsupported instruction", op); taken = 0; }
+      if (taken) { next = find_target(prog, pc, a); }
+      m->time += taken ? 2 : 1;
+    }
+    else
+    {
+      fail("unsupported instruction", op);
+    }
+
+    for (int lane = 0; lane < lanes; lane++)
+    {
+      uint8_t level = m->memory[s->port[lane]] >> s->pin[lane] & 1;
+      if (level != levels[lane])
+      {
+        if (count == max_edges) { fail("too many edges", NULL); }
+        edges[count++] = (edge){ m->time, lane, level };
+        levels[lane] = level;
+      }
+    }
+    pc = next;
+  }
+
+  if (depth != 0) { fail("the program finished inside a subroutine", NULL); }
+  return count;
+}
+
+//// Checking the waveforms
+
+typedef struct range
+{
+  uint32_t min, max;
+} range;
+
+static void extend(range * r, uint32_t value)
+{
+  if (value < r->min) { r->min = value; }
+  if (value > r->max) { r->max = value; }
+}
+
+typedef struct result
+{
+  range pulse[2];      // high time of a 0 and a 1, in cycles
+  range low[2];        // low time after a 0 and after a 1, not counting the last bit of a color
+  range period;        // from the start of one bit to the next in the same byte
+  uint32_t led_cycles; // the most cycles taken by one color
+} result;
+
+static uint32_t random_state = 1;
+
+static uint8_t random_byte()
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+
+// Simulates one writer at one F_CPU and timing profile, and returns the
+// number of errors.
+static int check(const writer * w, uint32_t f_cpu, const char * timing, result * r)
+{
+  static program prog;
+  static machine m;
+  settings s;
+
+  read_settings(w, f_cpu, timing, &s);
+  char * text = preprocess(w->file, f_cpu, timing);
+  parse(text, w->function, &prog);
+  free(text);
+
+  // Each strip's colors go in their own part of memory, as far from the ports
+  // as possible.  The first colors are all off and all on.
+  memset(&m, 0, sizeof(m));
+  rgb_color colors[SIM_MAX_LANES][SIM_LED_COUNT];
+  for (int lane = 0; lane < w->lanes; lane++)
+  {
+    for (int i = 0; i < SIM_LED_COUNT; i++)
+    {
+      uint8_t fill = i == 0 ? 0 : 255;
+      colors[lane][i] = i < 2 ? (rgb_color){ fill, fill, fill } :
+        (rgb_color){ random_byte(), random_byte(), random_byte() };
+    }
+    m.pointers[lane] = 0x8000 + lane * 0x1000;
+    memcpy(&m.memory[m.pointers[lane]], colors[lane], sizeof(colors[lane]));
+  }
+  for (int i = 0; i < prog.operand_count; i++)
+  {
+    if (prog.operands[i].kind == 'r') { m.registers[i] = prog.operands[i].value; }
+  }
+
+  memset(r, 0, sizeof(*r));
+  for (int i = 0; i < 2; i++) { r->pulse[i].min = r->low[i].min = UINT32_MAX; }
+  r->period.min = UINT32_MAX;
+
+  int errors = 0;
+  for (int i = 0; i < SIM_LED_COUNT; i++)
+  {
+    uint16_t expected_pointers[SIM_MAX_LANES];
+    for (int lane = 0; lane < w->lanes; lane++)
+    {
+      expected_pointers[lane] = m.pointers[lane] + sizeof(rgb_color);
+    }
+
+    edge edges[SIM_MAX_LANES * 48];
+    m.time = 0;
+    int edge_count = run(&prog, &m, &s, w->lanes, edges, ARRAY_LENGTH(edges));
+    if (m.time > r->led_cycles) { r->led_cycles = m.time; }
+
+    for (int lane = 0; lane < w->lanes; lane++)
+    {
+      if (m.pointers[lane] != expected_pointers[lane])
+      {
+        printf("  strip %d, color %d: the pointer moved by %d bytes\n", lane + 1, i,
+          m.pointers[lane] - expected_pointers[lane] + (int)sizeof(rgb_color));
+        errors++;
+        m.pointers[lane] = expected_pointers[lane];
+      }
+
+      // Each bit should be one rising edge followed by one falling edge.
+      uint32_t rise[24], fall[24];
+      int lane_edges = 0, bad = 0;
+      for (int e = 0; e < edge_count; e++)
+      {
+        if (edges[e].lane != lane) { continue; }
+        if (lane_edges == 48 || edges[e].level != !(lane_edges & 1))
+        {
+          bad = 1;
+          break;
+        }
+        (edges[e].level ? rise : fall)[lane_edges++ / 2] = edges[e].time;
+      }
+      if (bad || lane_edges != 48)
+      {
+        printf("  strip %d, color %d: expected 24 pulses\n", lane + 1, i);
+        errors++;
+        continue;
+      }
+
+      // The LEDs read a 1 if the pulse is longer than about halfway between a
+      // 0 pulse and a 1 pulse.
+      uint8_t sent[3] = { 0, 0, 0 };
+      for (int bit = 0; bit < 24; bit++)
+      {
+        uint32_t pulse = fall[bit] - rise[bit];
+        int value = 2 * (long long)pulse * 1000000000 >= (s.pulse_ns[0] + s.pulse_ns[1]) * (long long)f_cpu;
+        sent[bit / 8] |= value << (7 - bit % 8);
+
+        extend(&r->pulse[value], pulse);
+        if (bit < 23) { extend(&r->low[value], rise[bit + 1] - fall[bit]); }
+        if (bit % 8 != 7) { extend(&r->period, rise[bit + 1] - rise[bit]); }
+      }
+
+      uint8_t expected[3];
+      led_strip_encode(&colors[lane][i], 1, 256, expected);
+      if (memcmp(sent, expected, 3))
+      {
+        printf("  strip %d, color %d: sent %02X %02X %02X instead of %02X %02X %02X\n", lane + 1, i,
+          sent[0], sent[1], sent[2], expected[0], expected[1], expected[2]);
+        errors++;
+      }
+    }
+  }
+
+  for (int value = 0; value < 2; value++)
+  {
+    if (r->pulse[value].min * 1000000000LL < s.pulse_min_ns[value] * f_cpu ||
+      r->pulse[value].max * 1000000000LL > s.pulse_max_ns[value] * f_cpu)
+    {
+      printf("  a %d pulse is outside %lld-%lld ns\n", value, s.pulse_min_ns[value], s.pulse_max_ns[value]);
+      errors++;
+    }
+    if (r->low[value].min * 1000000000LL < s.low_min_ns[value] * f_cpu)
+    {
+      printf("  the line is low for less than %lld ns after a %d\n", s.low_min_ns[value], value);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+static double ns(uint32_t cycles, uint32_t f_cpu)
+{
+  return cycles * 1e9 / f_cpu;
+}
+
+int main(int argc, char ** argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s COMPILER [OPTIONS...]\n", argv[0]);
+    return 1;
+  }
+
+  // The compiler and its options are passed to the shell as they are.
+  for (int i = 1; i < argc; i++)
+  {
+    size_t length = strlen(compiler);
+    snprintf(compiler + length, sizeof(compiler) - length, "%s%s", i > 1 ? " " : "", argv[i]);
+  }
+
+  int errors = 0;
+  for (size_t c = 0; c < ARRAY_LENGTH(clocks); c++)
+  {
+    uint32_t f_cpu = clocks[c];
+    double single_led_ns = 0;
+
+    for (size_t wi = 0; wi < ARRAY_LENGTH(writers); wi++)
+    {
+      const writer * w = &writers[wi];
+      if (f_cpu == 8000000 && !w->supports_8mhz) { continue; }
+
+      for (size_t t = 0; t < (w->uses_timing ? ARRAY_LENGTH(timings) : 1); t++)
+      {
+        result r;
+        printf("%s at %lu MHz", w->file, (unsigned long)(f_cpu / 1000000));
+        if (w->uses_timing) { printf(" with LED_STRIP_TIMING_%s", timings[t]); }
+        printf(":\n");
+        fflush(stdout);
+
+        int e = check(w, f_cpu, timings[t], &r);
+        double led_ns = ns(r.led_cycles, f_cpu) / w->lanes;
+        printf("  0 pulse %.1f-%.1f ns, 1 pulse %.1f-%.1f ns\n",
+          ns(r.pulse[0].min, f_cpu), ns(r.pulse[0].max, f_cpu),
+          ns(r.pulse[1].min, f_cpu), ns(r.pulse[1].max, f_cpu));
+        printf("  low after a 0 %.1f-%.1f ns, after a 1 %.1f-%.1f ns\n",
+          ns(r.low[0].min, f_cpu), ns(r.low[0].max, f_cpu),
+          ns(r.low[1].min, f_cpu), ns(r.low[1].max, f_cpu));
+        printf("  period %.1f-%.1f ns, %.2f us per color per strip\n",
+          ns(r.period.min, f_cpu), ns(r.period.max, f_cpu), led_ns / 1000);
+
+        if (wi == 0 && t == 0)
+        {
+          single_led_ns = led_ns;
+        }
+        if (w->lanes > 1 && led_ns >= single_led_ns)
+        {
+          printf("  this is not faster than led_strip_write (%.2f us per color)\n", single_led_ns / 1000);
+          e++;
+        }
+        errors += e;
+      }
+    }
+  }
+
+  if (errors)
+  {
+    printf("%d errors\n", errors);
+    return 1;
+  }
+  printf("All checks passed.\n");
+  return 0;
+}
@@ -0,0 +1,60 @@
+// This is AVR code for driving the RGB LED strips from Pololu.
+//
+// This file provides led_strip_write, which sets up the pin and sends each
+// color with led_strip_send_color from led_strip.c or led_strip_ds.c (see
+// LED_STRIP_BACKEND in the Makefile).
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <stdint.h>
+#include "led_strip.h"
+
+#if LED_STRIP_CURRENT_LIMIT
+uint16_t led_strip_scale = 256;
+#endif
+
+// led_strip_write sends a series of colors to the LED strip, updating the LEDs.
+// The colors parameter should point to an array of rgb_color structs that hold
+// the colors to send.
+// The count parameter is the number of colors to send.
+// This function takes about 1.1 ms to update 30 LEDs.
+// Interrupts must be disabled during that time, so any interrupt-based library
+// can be negatively affected by this function.
+// See led_strip.c for the timing details.
+// If LED_STRIP_CURRENT_LIMIT is not 0, the colors are scaled down by the amount
+// needed to keep the previous call's colors within the limit.  The sum that
+// sets the next scale is taken while the colors are sent, so a sudden change
+// to a much brighter frame can exceed the limit for that one frame.
+void __attribute__((noinline)) led_strip_write(rgb_color * colors, uint16_t count)
+{
+  LED_STRIP_OUTPUT(LED_STRIP_PORT, LED_STRIP_DDR, LED_STRIP_PIN);
+
+#if LED_STRIP_CURRENT_LIMIT
+  uint32_t total = 0;  // sum of all the channels requested
+  uint16_t scale = led_strip_scale;
+#endif
+
+  LED_STRIP_BEGIN();
+  while (count--)
+  {
+#if LED_STRIP_CURRENT_LIMIT
+    // Add this color to the total and send a scaled copy of it instead.
+    // This just makes the line stay low a little longer between two LEDs.
+    total += colors->red + colors->green + colors->blue;
+    rgb_color scaled = led_strip_scale_color(colors, scale);
+    led_strip_send_color(&scaled);
+#else
+    led_strip_send_color(colors);
+#endif
+    colors++;
+
+    // Uncomment the line below to temporarily enable interrupts between each color.
+    //sei(); asm volatile("nop\n"); cli();
+  }
+  LED_STRIP_END();
+
+#if LED_STRIP_CURRENT_LIMIT
+  led_strip_scale = led_strip_next_scale(total);
+#endif
+}